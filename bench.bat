@@ -0,0 +1,13 @@
+@echo off
+if exist "C:\Program Files (x86)\Microsoft Visual Studio\2019\BuildTools\VC\Auxiliary\Build\vcvarsall.bat" (
+    call "C:\Program Files (x86)\Microsoft Visual Studio\2019\BuildTools\VC\Auxiliary\Build\vcvarsall.bat" x64
+) else (
+    call "C:\Program Files (x86)\Microsoft Visual Studio\2019\Community\VC\Auxiliary\Build\vcvarsall.bat" x64
+)
+
+REM SIMD kernel check and timing against scalar loops, add /arch:AVX2 to test the AVX2 path
+set compilerflags=/O2 /EHsc /std:c++17 /I include /I dependencies
+set linkerflags=/OUT:bin\bench.exe lib\glfw3dll.lib lib\vulkan-1.lib
+cl.exe %compilerflags% src\bench.cpp /link %linkerflags%
+del *.obj
+bin\bench.exe
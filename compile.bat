@@ -14,6 +14,12 @@ FOR %%F in (shaders/*.frag) DO (
         -o bin/shaders/%%~nF.spv
 )
 
+FOR %%F in (shaders/*.comp) DO (
+    echo Compiling: %%~nF
+    C:/VulkanSDK/1.2.131.2/Bin/glslc.exe shaders/%%~nF.comp ^
+        -o bin/shaders/%%~nF.spv
+)
+
 
 
 
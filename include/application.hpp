@@ -14,18 +14,30 @@ public:
 
     void draw()
     {
-        if(is_model_update()) return;  // do not render while model is loading
+        if(Input::Keys::L) start_model_load(); // current model keeps rendering while new one loads
         if(RECREATE_SWAPCHAIN) return; // do not render while swapchain is recreating
+        if(is_model_loaded) swap_model(); // frame boundary, nothing from previous frames is recorded yet
+        if(Input::Keys::R) rotate_model(); // same frame boundary, instance buffer is rewritten
 
         std::optional<uint32_t> next_image = swapchain.accquire_next_image();
         if(!next_image.has_value()) RECREATE_SWAPCHAIN = true; // recreate_swapchain();
 
         update_uniform_buffer(next_image.value());
+        if(recorded_draw_versions[next_image.value()] != model.draw_version) record_command_buffer(next_image.value()); // LOD or visibility changed
         
         bool is_presented = swapchain.present_image(next_image.value());
         if(!is_presented) RECREATE_SWAPCHAIN = true; // recreate_swapchain();
     }
 
+    /// culling statistics of last frame, shown in window title
+    std::string get_stats()
+    {
+        std::stringstream stats;
+        stats << "meshes " << model.instance_regions.size() - model.culled_instances << "/" << model.instance_regions.size();
+        if(model.visible_meshlets + model.culled_meshlets > 0) stats << ", clusters " << model.visible_meshlets << "/" << model.visible_meshlets + model.culled_meshlets;
+        return stats.str();
+    }
+
     void init_vulkan(GLFWwindow* window)
     {   
         this->instance.init(window);
@@ -33,12 +45,14 @@ public:
 
         this->render_pass = create_render_pass(&this->instance);
 
-        this->model_pipeline.init(&this->instance, &this->descriptors, &this->render_pass);
-        this->model_pipeline.create_graphics_pipeline();
-
         this->skybox_pipeline.init(&this->instance, &this->descriptors, &this->render_pass);
         this->skybox_pipeline.create_skybox_pipeline();
 
+        if(GPU_DRIVEN){ // not recreated with swapchain
+            this->cull_pipeline.init(&this->instance, &this->descriptors, &this->render_pass);
+            this->cull_pipeline.create_cull_pipeline();
+        }
+
         this->swapchain.init(&this->instance, &this->render_pass);
         
         Loader loader = Loader();
@@ -49,7 +63,8 @@ public:
         //model = loader.load("models/crate.glb");
         model = loader.load("models/cube.glb");
         //model = loader.load("models/tests/NormalTangentTest.glb");
-        model.prepare_model(&this->instance, &this->descriptors);
+        model.prepare_model(&this->instance, &this->descriptors, PACKED_VERTICES || model.quantized, GPU_DRIVEN);
+        create_model_pipelines(); // vertex layout is known after model is prepared
 
         camera.set_region(model.get_region());
 
@@ -66,7 +81,7 @@ public:
     void recreate_swapchain()
     {
         instance.update_surface_capabilities();
-        vkDeviceWaitIdle(instance.device);
+        instance.wait_idle();
 
         printf("---------------------\n");
         
@@ -74,11 +89,11 @@ public:
         this->swapchain.destroy();
         this->model_pipeline.destroy();
         this->skybox_pipeline.destroy();
+        if(DEPTH_PREPASS) this->depth_pipeline.destroy();
         vkDestroyCommandPool(instance.device, command_pool, nullptr);
 
         // recreate objects
-        this->model_pipeline.init(&this->instance, &this->descriptors, &this->render_pass);
-        this->model_pipeline.create_graphics_pipeline();
+        create_model_pipelines();
 
         this->skybox_pipeline.init(&this->instance, &this->descriptors, &this->render_pass);
         this->skybox_pipeline.create_skybox_pipeline();
@@ -93,13 +108,21 @@ public:
 
     void destroy()
     {
-        vkDeviceWaitIdle(instance.device);
+        if(load_thread.joinable()) load_thread.join();
+        if(is_model_loaded){ // loaded, but never shown
+            pending_model.destroy();
+            pending_descriptors.destroy();
+        }
+
+        instance.wait_idle();
 
         this->swapchain.destroy();
         this->descriptors.destroy();
         
         this->skybox_pipeline.destroy();
         this->model_pipeline.destroy();
+        if(DEPTH_PREPASS) this->depth_pipeline.destroy();
+        if(GPU_DRIVEN) this->cull_pipeline.destroy();
 
         enviroment_image.destroy();
         skybox.destroy();
@@ -115,6 +138,8 @@ private:
     Instance instance;
     Pipeline model_pipeline; 
     Pipeline skybox_pipeline;
+    Pipeline depth_pipeline; // only with DEPTH_PREPASS
+    Pipeline cull_pipeline; // compute, only with GPU_DRIVEN
     Descriptors descriptors;
     Swapchain swapchain;
     VkRenderPass render_pass;
@@ -122,48 +147,118 @@ private:
     Model model;
     Model skybox;
 
+    // model loaded in background, swapped with `model` and `descriptors` when ready
+    Model pending_model;
+    Descriptors pending_descriptors;
+    std::thread load_thread;
+    std::atomic<bool> is_model_loading = false;
+    std::atomic<bool> is_model_loaded = false;
+
     UniformPropertiesStruct properties = UniformPropertiesStruct(); 
     Camera camera = Camera();
 
     VkCommandPool command_pool;
     std::vector<VkCommandBuffer> command_buffers;
+    bool right_pressed = false; // right mouse button state of previous frame, picking runs on press
+    std::vector<uint64_t> recorded_draw_versions; // `model.draw_version` each command buffer was recorded with
 
     Image enviroment_image;
 
     //---------------------------------------------------------------------------------
 
-    bool is_model_update()
+    /// choose file, load and upload model on background thread
+    void start_model_load()
     {
-        if(Input::Keys::L == false) return false;
-
-        pfd::open_file f = pfd::open_file("Choose files to read", FILE_PATH, { "Model Files (.glb .gltf)", "*.glb *.gltf"}, false);
-        if(f.result().size() > 0){
-             vkDeviceWaitIdle(instance.device);
-            msg::printl("File selected from dialog: ", f.result()[0]);
-
-            vkDestroyCommandPool(instance.device, command_pool, nullptr);
-            this->descriptors.destroy();
-            this->model.destroy();
-            //-----------------------------------------
-            this->descriptors.init(&this->instance);
-            this->descriptors.bind_enviroment_image(&this->enviroment_image);
-            
-            Loader loader = Loader();
-            model = loader.load(f.result()[0].c_str());
-            model.prepare_model(&this->instance, &this->descriptors);
+        Input::Keys::L = false;
+        if(is_model_loading || is_model_loaded) return;
+        if(load_thread.joinable()) load_thread.join();
+
+        is_model_loading = true;
+        load_thread = std::thread([this](){
+            bool is_descriptors_created = false;
+            try{
+                pfd::open_file f = pfd::open_file("Choose files to read", FILE_PATH, { "Model Files (.glb .gltf)", "*.glb *.gltf"}, false);
+                if(f.result().size() > 0){
+                    msg::printl("File selected from dialog: ", f.result()[0]);
+
+                    Loader loader = Loader();
+                    pending_model = loader.load(f.result()[0].c_str());
+
+                    if(!pending_model.nodes.empty()){
+                        this->pending_descriptors.init(&this->instance);
+                        this->pending_descriptors.bind_enviroment_image(&this->enviroment_image);
+                        is_descriptors_created = true;
+
+                        pending_model.prepare_model(&this->instance, &this->pending_descriptors, PACKED_VERTICES || pending_model.quantized, GPU_DRIVEN);
+                        this->pending_descriptors.create_descriptor_sets();
+                        is_model_loaded = true;
+                    }
+                }else{
+                    msg::printl("No file selected from dialog");
+                }
+            }catch(const std::exception& e){
+                msg::error("Model load error: ", e.what());
+                pending_model.destroy();
+                pending_model = Model();
+                if(is_descriptors_created) pending_descriptors.destroy();
+            }
+            is_model_loading = false;
+        });
+    }
 
-            camera.set_region(model.get_region());
+    /// turn model around vertical axis through its center, node transforms change without rebuilding batches
+    void rotate_model()
+    {
+        Input::Keys::R = false;
+        if(model.nodes.empty()) return;
 
-            this->descriptors.create_descriptor_sets();
-            create_command_pool();
-            create_command_buffers();
+        Region region = model.get_region();
+        glm::vec3 center = (region.min + region.max) * 0.5f;
+        glm::mat4 rotation = glm::translate(glm::mat4(1.0), center) * glm::rotate(glm::mat4(1.0), glm::radians(15.0f), glm::vec3(0, 1, 0)) * glm::translate(glm::mat4(1.0), -center);
+        for(Node& node : model.nodes) node.cframe = rotation * node.cframe;
 
-        }else{
-            msg::printl("No file selected from dialog");
+        instance.wait_idle(); // frames in flight read instance and draw buffers
+        model.update_transforms(&this->descriptors);
+    }
+
+    /// model and depth pipelines for vertex layout of `model`
+    void create_model_pipelines()
+    {
+        this->model_pipeline.init(&this->instance, &this->descriptors, &this->render_pass);
+        this->model_pipeline.create_graphics_pipeline(model.is_packed());
+
+        if(DEPTH_PREPASS){
+            this->depth_pipeline.init(&this->instance, &this->descriptors, &this->render_pass);
+            this->depth_pipeline.create_depth_pipeline(model.is_packed());
         }
-        return false;
     }
-    
+
+    /// replace rendered model with fully uploaded `pending_model`
+    void swap_model()
+    {
+        instance.wait_idle(); // previous frames use old model
+        
+        vkDestroyCommandPool(instance.device, command_pool, nullptr);
+        this->descriptors.destroy();
+        this->model.destroy();
+        //-----------------------------------------
+        this->descriptors = this->pending_descriptors;
+        this->model = this->pending_model;
+        this->pending_model = Model();
+        is_model_loaded = false;
+
+        camera.set_region(model.get_region());
+
+        // new model can have other vertex layout (packed or float)
+        this->model_pipeline.destroy();
+        if(DEPTH_PREPASS) this->depth_pipeline.destroy();
+        create_model_pipelines();
+
+        create_command_pool();
+        create_command_buffers();
+        this->swapchain.bind_command_buffers(this->command_buffers.data());
+        msg::success("Model swapped");
+    }
 
     //---------------------------------------------------------------------------------
     void update_uniform_buffer(uint32_t current_image)
@@ -181,6 +276,41 @@ private:
         // ...
 
         descriptors.view_buffer.fill_memory(&ubo, sizeof(ubo));
+
+        glm::vec3 camera_position = glm::vec3(glm::inverse(ubo.view)[3]);
+        float pixel_scale = height / (2.0f * glm::tan(glm::radians(45.0f) / 2.0f));
+        if(GPU_DRIVEN){ // LOD and frustum test run in cull shader of recorded commands
+            model.update_culling(&descriptors, ubo.proj * ubo.view, camera_position, pixel_scale, current_image);
+        }else{
+            model.select_lods(camera_position, pixel_scale);
+            model.cull(ubo.proj * ubo.view, camera_position);
+        }
+
+        if(Input::Mouse::Right && !right_pressed) pick_under_cursor(ubo, width, height); // once per click
+        right_pressed = Input::Mouse::Right;
+    }
+
+    /// cast ray from camera through cursor and print what it hits
+    void pick_under_cursor(const UniformCameraStruct& ubo, float width, float height)
+    {
+        uint64_t start = timestamp_micro();
+
+        // viewport is flipped (negative height), so NDC y points up
+        glm::vec2 ndc(2.0f * Input::Mouse::Position.x / width - 1.0f, 1.0f - 2.0f * Input::Mouse::Position.y / height);
+        glm::mat4 inverse = glm::inverse(ubo.proj * ubo.view);
+        glm::vec4 near_point = inverse * glm::vec4(ndc, 0.0f, 1.0f);
+        glm::vec4 far_point = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+        glm::vec3 origin = glm::vec3(near_point) / near_point.w;
+
+        PickResult result = model.pick(Ray(origin, glm::vec3(far_point) / far_point.w - origin));
+        float time = (float)(timestamp_micro() - start) / 1000;
+
+        if(!result.hit){
+            msg::printl("Pick: nothing (", time, " ms)");
+            return;
+        }
+        msg::printl("Pick: node '", result.node? result.node->name : "?", "', mesh '", result.mesh? result.mesh->name : "?",
+            "', triangle ", result.triangle, ", point ", result.position, " (", time, " ms)");
     }
 
     //---------------------------------------------------------------------------------
@@ -188,7 +318,7 @@ private:
     void create_command_pool()
     {
         VkCommandPoolCreateInfo ci = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
-        ci.flags = 0;
+        ci.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // buffers are re-recorded when LOD or visibility changes
         ci.queueFamilyIndex = instance.queues.graphics_family_index;
 
         if(vkCreateCommandPool(instance.device, &ci, nullptr, &this->command_pool) != VK_SUCCESS){
@@ -209,11 +339,21 @@ private:
             throw std::runtime_error("failed to allocate command buffers!");
         };
 
+        recorded_draw_versions.resize(command_buffers.size());
+        for(uint32_t i = 0; i < command_buffers.size(); i++) record_command_buffer(i);
+
+        printf("Recorded commands \n");
+    }
+
+    /// record draw commands of swapchain image `i`, command buffer must not be in use
+    void record_command_buffer(uint32_t i)
+    {
+        recorded_draw_versions[i] = model.draw_version;
+
         std::array<VkClearValue, 2> clear_values = {};
         clear_values[0].color = {0.0, 0.0, 0.0, 1.0};
         clear_values[1].depthStencil = {1.0, 0};
 
-        for(int i = 0; i < command_buffers.size(); i++)
         { 
             // render pass info for recodring
             VkRenderPassBeginInfo render_pass_bi = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
@@ -238,6 +378,11 @@ private:
             
             // RECORD START
 
+            if(GPU_DRIVEN){ // indirect commands of this frame, before render pass
+                vkCmdBindPipeline(command_buffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, this->cull_pipeline.graphics_pipeline);
+                model.record_culling(&command_buffers[i], &cull_pipeline.pipeline_layout, &descriptors, i);
+            }
+
             vkCmdBeginRenderPass(command_buffers[i], &render_pass_bi, VK_SUBPASS_CONTENTS_INLINE);
             // VK_SUBPASS_CONTENTS_INLINE - render pass commands will be embedded in the primary command buffer itself, no secondary buffers.
             // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS - The render pass commands will be executed from secondary command buffers.
@@ -248,8 +393,15 @@ private:
             
             //------------------------------------------
             
+            if(DEPTH_PREPASS){ // fill depth from position stream, shading runs once per visible pixel
+                vkCmdBindPipeline(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, this->depth_pipeline.graphics_pipeline);
+                if(GPU_DRIVEN) model.draw_indirect(&command_buffers[i], &depth_pipeline.pipeline_layout, &descriptors, true);
+                else model.draw(&command_buffers[i], &depth_pipeline.pipeline_layout, &descriptors, true);
+            }
+
             vkCmdBindPipeline(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, this->model_pipeline.graphics_pipeline);
-            model.draw(&command_buffers[i], &model_pipeline.pipeline_layout, &descriptors);
+            if(GPU_DRIVEN) model.draw_indirect(&command_buffers[i], &model_pipeline.pipeline_layout, &descriptors);
+            else model.draw(&command_buffers[i], &model_pipeline.pipeline_layout, &descriptors);
             
             //------------------------------------------
             vkCmdEndRenderPass(command_buffers[i]);
@@ -260,8 +412,6 @@ private:
                 throw std::runtime_error("failed to record command buffer!");
             }
         }
-
-        printf("Recorded commands \n");
     }
 
     void create_enviroment_buffer()
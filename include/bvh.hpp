@@ -0,0 +1,318 @@
+#pragma once
+#include "common.hpp"
+
+//-------------------------------------------------------------------
+// Bounding volume hierarchy over world regions (binned SAH build).
+// Children of a node are stored as pair (`first`, `first + 1`) after their parent,
+// so refit is one reverse pass over nodes and topology is kept when regions move.
+
+const uint32_t BVH_BINS = 16; // split candidates per axis
+const uint32_t BVH_LEAF_SIZE = 4; // node with this many items is always leaf
+const uint32_t BVH_MAX_LEAF_SIZE = 16; // larger node is split even if SAH prefers leaf
+const uint32_t BVH_MIN_INSTANCES = 1024; // smaller scenes are frustum tested by linear SIMD scan
+
+struct Ray{
+    glm::vec3 origin = glm::vec3(0);
+    glm::vec3 direction = glm::vec3(0, 0, -1); // not normalized after transform, distances are in `direction` units
+    glm::vec3 inverse_direction = glm::vec3(0);
+
+    Ray(){}
+    Ray(const glm::vec3& origin, const glm::vec3& direction) : origin(origin), direction(direction), inverse_direction(1.0f / direction){}
+
+    /// same ray in space of `inverse` transform, distances stay comparable
+    Ray transformed(const glm::mat4& inverse) const { return Ray(glm::vec3(inverse * glm::vec4(origin, 1.0f)), glm::vec3(inverse * glm::vec4(direction, 0.0f))); }
+};
+
+struct BvhNode{
+    Region region;
+    uint32_t first = 0; // leaf - first item in `items`, inner - left child (right is `first + 1`)
+    uint32_t count = 0; // items in leaf, 0 - inner node
+};
+
+class Bvh{
+public:
+    std::vector<BvhNode> nodes; // root first
+    std::vector<uint32_t> items; // region indices, leaves refer to ranges of it
+
+    //----------------------------------------------------
+    /// build over `regions`, previous tree is replaced
+
+    void build(const std::vector<Region>& regions)
+    {
+        nodes.clear();
+        items.resize(regions.size());
+        for(uint32_t i = 0; i < items.size(); i++) items[i] = i;
+        if(regions.empty()) return;
+
+        nodes.reserve(regions.size() * 2);
+        nodes.push_back({ Region(), 0, (uint32_t)items.size() });
+
+        std::vector<uint32_t> stack = { 0 };
+        while(!stack.empty())
+        {
+            uint32_t index = stack.back();
+            stack.pop_back();
+
+            BvhNode node = nodes[index];
+            nodes[index].region = merge(regions, node.first, node.count);
+
+            uint32_t split = split_items(regions, node.first, node.count, nodes[index].region);
+            if(split == 0) continue; // leaf
+
+            uint32_t left = (uint32_t)nodes.size();
+            nodes.push_back({ Region(), node.first, split });
+            nodes.push_back({ Region(), node.first + split, node.count - split });
+            nodes[index].first = left;
+            nodes[index].count = 0;
+
+            stack.push_back(left);
+            stack.push_back(left + 1);
+        }
+    }
+
+    /// recompute node regions after `regions` moved, items keep their leaves
+    void refit(const std::vector<Region>& regions)
+    {
+        for(size_t i = nodes.size(); i-- > 0;){
+            BvhNode& node = nodes[i];
+            if(node.count > 0) node.region = merge(regions, node.first, node.count);
+            else node.region = merge(nodes[node.first].region, nodes[node.first + 1].region);
+        }
+    }
+
+    //----------------------------------------------------
+    /// `visible[item]` is set to 1 for items whose region intersects frustum (other entries are set to 0),
+    /// nodes fully inside frustum are accepted without testing their items
+
+    void cull(const std::vector<Region>& regions, const Frustum& frustum, uint8_t* visible) const
+    {
+        std::fill(visible, visible + items.size(), (uint8_t)0);
+        if(nodes.empty()) return;
+
+        std::vector<std::pair<uint32_t, bool>> stack = { { 0, false } }; // node, parent is fully inside
+        while(!stack.empty())
+        {
+            auto [index, inside] = stack.back();
+            stack.pop_back();
+            const BvhNode& node = nodes[index];
+
+            if(!inside){
+                if(!frustum.intersects(node.region)) continue;
+                inside = frustum.contains(node.region);
+            }
+
+            if(node.count == 0){
+                stack.push_back({ node.first, inside });
+                stack.push_back({ node.first + 1, inside });
+                continue;
+            }
+
+            for(uint32_t i = node.first; i < node.first + node.count; i++){
+                visible[items[i]] = inside || frustum.intersects(regions[items[i]]);
+            }
+        }
+    }
+
+    /// `visit(item)` for every item whose region overlaps `region`
+    template<typename FUNCTION>
+    void query(const std::vector<Region>& regions, const Region& region, FUNCTION visit) const
+    {
+        if(nodes.empty()) return;
+
+        std::vector<uint32_t> stack = { 0 };
+        while(!stack.empty())
+        {
+            const BvhNode& node = nodes[stack.back()];
+            stack.pop_back();
+            if(!overlaps(node.region, region)) continue;
+
+            if(node.count == 0){
+                stack.push_back(node.first);
+                stack.push_back(node.first + 1);
+                continue;
+            }
+            for(uint32_t i = node.first; i < node.first + node.count; i++) if(overlaps(regions[items[i]], region)) visit(items[i]);
+        }
+    }
+
+    /// closest-first ray traversal, `visit(item, max_distance)` tests item and lowers `max_distance` on hit
+    template<typename FUNCTION>
+    void traverse(const Ray& ray, float& max_distance, FUNCTION visit) const
+    {
+        if(nodes.empty() || intersect(ray, nodes[0].region, max_distance) == FLT_MAX) return;
+
+        std::vector<std::pair<uint32_t, float>> stack = { { 0, 0.0f } }; // node, entry distance
+        while(!stack.empty())
+        {
+            auto [index, entry] = stack.back();
+            stack.pop_back();
+            if(entry >= max_distance) continue; // closer hit was found after push
+            const BvhNode& node = nodes[index];
+
+            if(node.count > 0){
+                for(uint32_t i = node.first; i < node.first + node.count; i++) visit(items[i], max_distance);
+                continue;
+            }
+
+            float left = intersect(ray, nodes[node.first].region, max_distance);
+            float right = intersect(ray, nodes[node.first + 1].region, max_distance);
+            if(left > right){ // nearer child is popped first
+                if(left != FLT_MAX) stack.push_back({ node.first, left });
+                stack.push_back({ node.first + 1, right });
+            }else{
+                if(right != FLT_MAX) stack.push_back({ node.first + 1, right });
+                if(left != FLT_MAX) stack.push_back({ node.first, left });
+            }
+        }
+    }
+
+    //----------------------------------------------------
+
+    /// slab test, entry distance or FLT_MAX if ray misses box before `max_distance`
+    static float intersect(const Ray& ray, const Region& region, float max_distance)
+    {
+        glm::vec3 t0 = (region.min - ray.origin) * ray.inverse_direction;
+        glm::vec3 t1 = (region.max - ray.origin) * ray.inverse_direction;
+        glm::vec3 enter = glm::min(t0, t1), leave = glm::max(t0, t1);
+        float entry = std::max({ enter.x, enter.y, enter.z, 0.0f });
+        float exit = std::min({ leave.x, leave.y, leave.z, max_distance });
+        return entry <= exit? entry : FLT_MAX;
+    }
+
+    /// Moller-Trumbore, both sides are hit, distance or FLT_MAX
+    static float intersect(const Ray& ray, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+    {
+        glm::vec3 edge1 = p1 - p0, edge2 = p2 - p0;
+        glm::vec3 p = glm::cross(ray.direction, edge2);
+        float determinant = glm::dot(edge1, p);
+        if(std::abs(determinant) < 1e-20f) return FLT_MAX;
+
+        float inverse = 1.0f / determinant;
+        glm::vec3 s = ray.origin - p0;
+        float u = glm::dot(s, p) * inverse;
+        if(u < 0 || u > 1) return FLT_MAX;
+
+        glm::vec3 q = glm::cross(s, edge1);
+        float v = glm::dot(ray.direction, q) * inverse;
+        if(v < 0 || u + v > 1) return FLT_MAX;
+
+        float distance = glm::dot(edge2, q) * inverse;
+        return distance >= 0? distance : FLT_MAX;
+    }
+
+    static Region merge(const Region& a, const Region& b){ return Region(glm::min(a.min, b.min), glm::max(a.max, b.max)); }
+
+    static bool overlaps(const Region& a, const Region& b)
+    {
+        return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y && a.min.z <= b.max.z && a.max.z >= b.min.z;
+    }
+
+    static float area(const Region& r)
+    {
+        glm::vec3 size = glm::max(r.max - r.min, glm::vec3(0));
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+
+private:
+
+    Region merge(const std::vector<Region>& regions, uint32_t first, uint32_t count) const
+    {
+        Region result = regions[items[first]];
+        for(uint32_t i = first + 1; i < first + count; i++) result = merge(result, regions[items[i]]);
+        return result;
+    }
+
+    /// binned SAH over item centers, partitions items and returns left count, 0 - node stays leaf
+    uint32_t split_items(const std::vector<Region>& regions, uint32_t first, uint32_t count, const Region& bounds)
+    {
+        if(count <= BVH_LEAF_SIZE) return 0;
+
+        Region centers(glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+        for(uint32_t i = first; i < first + count; i++){
+            glm::vec3 center = (regions[items[i]].min + regions[items[i]].max) * 0.5f;
+            centers.min = glm::min(centers.min, center);
+            centers.max = glm::max(centers.max, center);
+        }
+
+        struct Bin{
+            Region region = Region(glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+            uint32_t count = 0;
+        };
+
+        float best_cost = FLT_MAX;
+        int best_axis = -1;
+        uint32_t best_bin = 0;
+
+        for(int axis = 0; axis < 3; axis++)
+        {
+            float extent = centers.max[axis] - centers.min[axis];
+            if(extent <= 0) continue;
+            float scale = BVH_BINS / extent;
+
+            std::array<Bin, BVH_BINS> bins;
+            for(uint32_t i = first; i < first + count; i++){
+                const Region& region = regions[items[i]];
+                uint32_t bin = std::min(BVH_BINS - 1, (uint32_t)(((region.min[axis] + region.max[axis]) * 0.5f - centers.min[axis]) * scale));
+                bins[bin].region = merge(bins[bin].region, region);
+                bins[bin].count++;
+            }
+
+            // sweep from right, then evaluate every plane from left
+            std::array<float, BVH_BINS> right_cost;
+            Bin right;
+            for(uint32_t b = BVH_BINS - 1; b > 0; b--){
+                right.region = merge(right.region, bins[b].region);
+                right.count += bins[b].count;
+                right_cost[b] = right.count > 0? area(right.region) * right.count : 0;
+            }
+
+            Bin left;
+            for(uint32_t b = 0; b < BVH_BINS - 1; b++){
+                left.region = merge(left.region, bins[b].region);
+                left.count += bins[b].count;
+                if(left.count == 0 || left.count == count) continue;
+
+                float cost = area(left.region) * left.count + right_cost[b + 1];
+                if(cost < best_cost){
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = b;
+                }
+            }
+        }
+
+        // all centers in one point, halve by count
+        if(best_axis == -1) return count > BVH_MAX_LEAF_SIZE? count / 2 : 0;
+        if(best_cost >= area(bounds) * count && count <= BVH_MAX_LEAF_SIZE) return 0;
+
+        float scale = BVH_BINS / (centers.max[best_axis] - centers.min[best_axis]);
+        auto middle = std::partition(items.begin() + first, items.begin() + first + count, [&](uint32_t item){
+            const Region& region = regions[item];
+            uint32_t bin = std::min(BVH_BINS - 1, (uint32_t)(((region.min[best_axis] + region.max[best_axis]) * 0.5f - centers.min[best_axis]) * scale));
+            return bin <= best_bin;
+        });
+        return (uint32_t)(middle - (items.begin() + first));
+    }
+};
+
+//-------------------------------------------------------------------
+/// BVH over triangles of one index range, regions are in geometry space
+
+struct TriangleBvh{
+    Bvh bvh;
+    std::vector<Region> regions; // per triangle
+    uint32_t first_index = 0;
+
+    void build(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, uint32_t first_index, uint32_t index_count)
+    {
+        this->first_index = first_index;
+        regions.resize(index_count / 3);
+        for(uint32_t t = 0; t < regions.size(); t++){
+            const glm::vec3& p0 = vertices[indices[first_index + t*3 + 0]].position;
+            const glm::vec3& p1 = vertices[indices[first_index + t*3 + 1]].position;
+            const glm::vec3& p2 = vertices[indices[first_index + t*3 + 2]].position;
+            regions[t] = Region(glm::min(p0, glm::min(p1, p2)), glm::max(p0, glm::max(p1, p2)));
+        }
+        bvh.build(regions);
+    }
+};
@@ -0,0 +1,358 @@
+#pragma once
+#include "common.hpp"
+
+//-------------------------------------------------------------------
+/// Preprocessed model cache (`cache/*.vkvcache`), stores finished geometry (after TBN, LODs and meshlets),
+/// resized texture layers, node hierarchy and draw infos. Repeat open is map + memcpy.
+
+const uint32_t CACHE_MAGIC = 0x4356564B; // "KVVC"
+const uint32_t CACHE_VERSION = 12;
+const char* CACHE_FOLDER = "cache/";
+
+class ModelCache{
+public:
+
+    /// files besides source that model was built from (.bin buffers, images), part of cache key
+    std::vector<std::string> dependencies;
+
+    //----------------------------------------------------
+    /// fill `model` from cache, false if cache is missing or stale
+
+    bool read(const std::string& source, Model& model)
+    {
+        try{
+            std::string path = get_cache_path(source);
+            if(!std::filesystem::exists(path)) return false;
+
+            MappedFile file;
+            file.map(path);
+            this->data = file.data;
+            this->size = file.size;
+            this->position = 0;
+
+            // header
+            if(read_value<uint32_t>() != CACHE_MAGIC) return false;
+            if(read_value<uint32_t>() != CACHE_VERSION) return false;
+            if(read_string() != source) return false;
+            // matching size and time are trusted, content is hashed only when stamp differs (touched or copied file)
+            bool is_unchanged = is_file_unchanged(source);
+            uint64_t source_hash = read_value<uint64_t>();
+            if(!is_unchanged && source_hash != hash_file(source)) return false;
+
+            uint32_t dependency_count = read_value<uint32_t>();
+            for(uint32_t i = 0; i < dependency_count; i++){
+                if(!is_file_unchanged(read_string())) return false;
+            }
+
+            // textures
+            std::map<int32_t, std::shared_ptr<const std::vector<uint8_t>>> images;
+            uint32_t image_count = read_value<uint32_t>();
+            for(uint32_t i = 0; i < image_count; i++){
+                int32_t image = read_value<int32_t>();
+                auto pixels = std::make_shared<std::vector<uint8_t>>(MAX_IMAGE_SIZE * MAX_IMAGE_SIZE * 4);
+                read_array(pixels->data(), pixels->size());
+                images[image] = pixels;
+            }
+
+            // geometry
+            model = Model();
+            model.total_indices_size = read_value<uint32_t>();
+            model.total_vertices_size = read_value<uint32_t>();
+            model.quantized = read_value<uint8_t>() != 0;
+            model.geometries.resize(read_value<uint32_t>());
+            for(std::shared_ptr<Geometry>& geometry : model.geometries){
+                geometry = std::make_shared<Geometry>();
+                read_geometry(*geometry);
+            }
+
+            // hierarchy
+            model.nodes.resize(read_value<uint32_t>());
+            for(Node& node : model.nodes) read_node(node, images, model.geometries);
+
+            model.infos.resize(read_value<uint32_t>());
+            read_array(model.infos.data(), model.infos.size());
+
+            this->data = nullptr;
+            msg::success("Model loaded from cache: ", path);
+            return true;
+
+        }catch(const std::exception& e){
+            this->data = nullptr;
+            msg::warn("Cache: ", e.what());
+            return false;
+        }
+    }
+
+    //----------------------------------------------------
+    /// write finished model, failures only print warning
+
+    void write(const std::string& source, const Model& model)
+    {
+        try{
+            std::filesystem::create_directories(CACHE_FOLDER);
+            std::string path = get_cache_path(source);
+            this->output.clear();
+
+            // header
+            write_value(CACHE_MAGIC);
+            write_value(CACHE_VERSION);
+            write_string(source);
+            write_file_stamp(source);
+            write_value(hash_file(source));
+
+            write_value((uint32_t)dependencies.size());
+            for(const std::string& dependency : dependencies){
+                write_string(dependency);
+                write_file_stamp(dependency);
+            }
+
+            // textures, each image once
+            std::map<int32_t, const std::vector<uint8_t>*> images;
+            for(const Node& node : model.nodes) collect_images(node, images);
+
+            write_value((uint32_t)images.size());
+            for(auto& image : images){
+                write_value(image.first);
+                write_array(image.second->data(), image.second->size());
+            }
+
+            // geometry, meshes refer to it by index
+            std::map<const Geometry*, uint32_t> geometry_ids;
+            write_value(model.total_indices_size);
+            write_value(model.total_vertices_size);
+            write_value((uint8_t)model.quantized);
+            write_value((uint32_t)model.geometries.size());
+            for(const std::shared_ptr<Geometry>& geometry : model.geometries){
+                uint32_t id = (uint32_t)geometry_ids.size();
+                geometry_ids[geometry.get()] = id;
+                write_geometry(*geometry);
+            }
+
+            // hierarchy
+            write_value((uint32_t)model.nodes.size());
+            for(const Node& node : model.nodes) write_node(node, geometry_ids);
+
+            write_value((uint32_t)model.infos.size());
+            write_array(model.infos.data(), model.infos.size());
+
+            std::ofstream file(path, std::ios::binary);
+            file.write(output.data(), output.size());
+            if(!file) throw std::runtime_error("failed to write " + path);
+            file.close();
+
+            msg::success("Model cache written: ", path, " (", (float)output.size()/1024/1024, " MB)");
+        }catch(const std::exception& e){
+            msg::warn("Cache: ", e.what());
+        }
+        this->output.clear();
+        this->output.shrink_to_fit();
+    }
+
+private:
+    const char* data = nullptr; // mapped cache file while reading
+    size_t size = 0;
+    size_t position = 0;
+    std::vector<char> output; // cache file while writing
+
+    //----------------------------------------------------
+
+    /// 64-bit FNV-1a
+    uint64_t hash(const char* bytes, size_t length, uint64_t value = 14695981039346656037ull)
+    {
+        for(size_t i = 0; i < length; i++){
+            value ^= (uint8_t)bytes[i];
+            value *= 1099511628211ull;
+        }
+        return value;
+    }
+
+    /// content hash, 8 bytes are mixed per step so large files hash at memory speed
+    uint64_t hash_file(const std::string& path)
+    {
+        MappedFile file;
+        file.map(path);
+
+        uint64_t value = 14695981039346656037ull;
+        size_t words = file.size / 8;
+        for(size_t i = 0; i < words; i++){
+            uint64_t word;
+            std::memcpy(&word, file.data + i * 8, 8);
+            value = (value ^ word) * 1099511628211ull;
+        }
+        return hash(file.data + words * 8, file.size - words * 8, value);
+    }
+
+    std::string get_cache_path(const std::string& source)
+    {
+        std::stringstream name;
+        name << CACHE_FOLDER << std::hex << std::setw(16) << std::setfill('0') << hash(source.data(), source.size()) << ".vkvcache";
+        return name.str();
+    }
+
+    //----------------------------------------------------
+    // file size and modification time
+
+    void write_file_stamp(const std::string& path)
+    {
+        write_value((uint64_t)std::filesystem::file_size(path));
+        write_value((uint64_t)std::filesystem::last_write_time(path).time_since_epoch().count());
+    }
+
+    bool is_file_unchanged(const std::string& path)
+    {
+        uint64_t file_size = read_value<uint64_t>();
+        uint64_t file_time = read_value<uint64_t>();
+
+        std::error_code error;
+        if(!std::filesystem::exists(path, error)) return false;
+        return file_size == (uint64_t)std::filesystem::file_size(path) && file_time == (uint64_t)std::filesystem::last_write_time(path).time_since_epoch().count();
+    }
+
+    //----------------------------------------------------
+    // writing, arrays are 16 byte aligned in file
+
+    template<typename TYPE>
+    void write_value(const TYPE& value){ write_bytes(&value, sizeof(TYPE)); }
+
+    void write_bytes(const void* bytes, size_t length)
+    {
+        const char* begin = reinterpret_cast<const char*>(bytes);
+        output.insert(output.end(), begin, begin + length);
+    }
+
+    void write_string(const std::string& text)
+    {
+        write_value((uint32_t)text.size());
+        write_bytes(text.data(), text.size());
+    }
+
+    template<typename TYPE>
+    void write_array(const TYPE* values, size_t count)
+    {
+        output.resize((output.size() + 15) & ~(size_t)15, 0);
+        write_bytes(values, count * sizeof(TYPE));
+    }
+
+    void write_geometry(const Geometry& geometry)
+    {
+        write_value(geometry.region);
+        write_value(geometry.ioffset);
+        write_value(geometry.voffset);
+        write_value(geometry.moffset);
+
+        write_value((uint32_t)geometry.indices.size());
+        write_array(geometry.indices.data(), geometry.indices.size());
+        write_value((uint32_t)geometry.vertices.size());
+        write_array(geometry.vertices.data(), geometry.vertices.size());
+        write_value((uint32_t)geometry.lods.size());
+        write_array(geometry.lods.data(), geometry.lods.size());
+        write_value((uint32_t)geometry.meshlets.size());
+        write_array(geometry.meshlets.data(), geometry.meshlets.size());
+    }
+
+    void write_node(const Node& node, const std::map<const Geometry*, uint32_t>& geometry_ids)
+    {
+        write_string(node.name);
+        write_value(node.cframe);
+
+        write_value((uint32_t)node.meshes.size());
+        for(const Mesh& mesh : node.meshes){
+            write_string(mesh.name);
+            write_value(geometry_ids.at(mesh.geometry.get()));
+            write_value(mesh.textures);
+            write_value(mesh.uniform);
+            write_value(mesh.id);
+            write_value(mesh.material);
+            write_value(mesh.double_sided);
+        }
+
+        write_value((uint32_t)node.instances.size());
+        write_array(node.instances.data(), node.instances.size());
+
+        write_value((uint32_t)node.children.size());
+        for(const Node& child : node.children) write_node(child, geometry_ids);
+    }
+
+    void collect_images(const Node& node, std::map<int32_t, const std::vector<uint8_t>*>& images)
+    {
+        for(const Mesh& mesh : node.meshes){
+            if(mesh.textures.albedo != -1) images[mesh.textures.albedo] = mesh.pixels.albedo.get();
+            if(mesh.textures.normal != -1) images[mesh.textures.normal] = mesh.pixels.normal.get();
+            if(mesh.textures.material != -1) images[mesh.textures.material] = mesh.pixels.material.get();
+            if(mesh.textures.emission != -1) images[mesh.textures.emission] = mesh.pixels.emission.get();
+        }
+        for(const Node& child : node.children) collect_images(child, images);
+    }
+
+    //----------------------------------------------------
+    // reading, throws if cache file ends early
+
+    void read_bytes(void* destination, size_t length)
+    {
+        if(position + length > size) throw std::runtime_error("cache file is corrupted");
+        std::memcpy(destination, data + position, length);
+        position += length;
+    }
+
+    template<typename TYPE>
+    TYPE read_value(){ TYPE value; read_bytes(&value, sizeof(TYPE)); return value; }
+
+    std::string read_string()
+    {
+        std::string text(read_value<uint32_t>(), '\0');
+        read_bytes(&text[0], text.size());
+        return text;
+    }
+
+    template<typename TYPE>
+    void read_array(TYPE* values, size_t count)
+    {
+        position = (position + 15) & ~(size_t)15;
+        read_bytes(values, count * sizeof(TYPE));
+    }
+
+    void read_geometry(Geometry& geometry)
+    {
+        geometry.region = read_value<Region>();
+        geometry.ioffset = read_value<uint32_t>();
+        geometry.voffset = read_value<uint32_t>();
+        geometry.moffset = read_value<uint32_t>();
+
+        geometry.indices.resize(read_value<uint32_t>());
+        read_array(geometry.indices.data(), geometry.indices.size());
+        geometry.vertices.resize(read_value<uint32_t>());
+        read_array(geometry.vertices.data(), geometry.vertices.size());
+        geometry.lods.resize(read_value<uint32_t>());
+        read_array(geometry.lods.data(), geometry.lods.size());
+        geometry.meshlets.resize(read_value<uint32_t>());
+        read_array(geometry.meshlets.data(), geometry.meshlets.size());
+    }
+
+    void read_node(Node& node, const std::map<int32_t, std::shared_ptr<const std::vector<uint8_t>>>& images, const std::vector<std::shared_ptr<Geometry>>& geometries)
+    {
+        node.name = read_string();
+        node.cframe = read_value<glm::mat4>();
+
+        node.meshes.resize(read_value<uint32_t>());
+        for(Mesh& mesh : node.meshes){
+            mesh.name = read_string();
+            mesh.geometry = geometries.at(read_value<uint32_t>());
+            mesh.textures = read_value<Mesh::Textures>();
+            mesh.uniform = read_value<Mesh::UniformMeshStruct>();
+            mesh.id = read_value<uint32_t>();
+            mesh.material = read_value<int32_t>();
+            mesh.double_sided = read_value<bool>();
+
+            if(mesh.textures.albedo != -1) mesh.pixels.albedo = images.at(mesh.textures.albedo);
+            if(mesh.textures.normal != -1) mesh.pixels.normal = images.at(mesh.textures.normal);
+            if(mesh.textures.material != -1) mesh.pixels.material = images.at(mesh.textures.material);
+            if(mesh.textures.emission != -1) mesh.pixels.emission = images.at(mesh.textures.emission);
+        }
+
+        node.instances.resize(read_value<uint32_t>());
+        read_array(node.instances.data(), node.instances.size());
+
+        node.children.resize(read_value<uint32_t>());
+        for(Node& child : node.children) read_node(child, images, geometries);
+    }
+};
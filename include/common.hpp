@@ -13,6 +13,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtx/scalar_multiplication.hpp>
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -40,20 +41,35 @@
 #include <string>  
 #include <chrono>
 #include <array>
+#include <tuple>
 #include <set>
+#include <map>
+#include <memory>
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <filesystem>
+#include <sstream>
 
 //-----------------------------------------
 // Globals
 
 const uint32_t MAX_OBJECTS = 256;
+const uint32_t MAX_INSTANCES = 65536;
 const uint32_t MAX_IMAGES = 32;
 const uint32_t MAX_IMAGE_SIZE = 512;
+const uint32_t MAX_LODS = 4; // levels of detail per geometry, LOD 0 is full detail
+const float LOD_PIXEL_ERROR = 1.0f; // simplification error allowed on screen
 const uint32_t DYNAMIC_DESCRIPTOR_SIZE = 256;
 
 bool APP_DEBUG = false;
+bool PACKED_VERTICES = false; // `packed` program argument, models use `PackedVertex`
+bool DEPTH_PREPASS = false; // `prepass` program argument, depth only pass over position stream before shading
+bool GPU_DRIVEN = false; // `gpu` program argument, compute shader culls instances and writes indirect draws
 const char* TITLE = "VkVisualiser";
 const int MAX_FRAMES_IN_FLIGHT = 2;
+const uint32_t MAX_SWAPCHAIN_IMAGES = 8; // statistic slots of GPU driven count buffer, one per command buffer
 bool APP_RUNNING = true;
 bool RECREATE_SWAPCHAIN = false;
 HANDLE H_CONSOLE = GetStdHandle(STD_OUTPUT_HANDLE);
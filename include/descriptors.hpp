@@ -30,6 +30,13 @@ public:
         view_buffer.destroy();
         properties_buffer.destroy();
         dynamic_uniform_buffer.destroy();
+        instance_buffer.destroy();
+        draw_buffer.destroy();
+        indirect_buffer.destroy();
+        if(counts != nullptr) count_buffer.unmap();
+        count_buffer.destroy();
+        material_buffer.destroy();
+        culling_buffer.destroy();
 
         this->albedo.destroy(); 
         this->normal.destroy(); 
@@ -47,6 +54,15 @@ public:
     Buffer view_buffer;
     Buffer properties_buffer;
     Buffer dynamic_uniform_buffer;
+    Buffer instance_buffer; // mat4 per instance, indexed by gl_InstanceIndex
+
+    // GPU driven rendering, minimal size without GPU_DRIVEN
+    Buffer draw_buffer; // `IndirectDrawStruct` per instance
+    Buffer indirect_buffer; // `VkDrawIndexedIndirectCommand` per instance, written by cull shader
+    Buffer count_buffer; // visible draws of 16-bit and 32-bit index buffer, then copy of them per swapchain image
+    Buffer material_buffer; // `UniformMeshStruct` per batch slot, indexed by draw instead of dynamic offset
+    Buffer culling_buffer; // `UniformCullingStruct`
+    uint32_t* counts = nullptr; // `count_buffer` mapped once for statistics
 
     Image *enviroment;
     Image albedo; 
@@ -115,6 +131,34 @@ public:
         size = DYNAMIC_DESCRIPTOR_SIZE * MAX_OBJECTS; // sizeof(Material) 
         dynamic_uniform_buffer.init(this->instance);
         dynamic_uniform_buffer.create_buffer(size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        size = sizeof(glm::mat4) * MAX_INSTANCES;
+        instance_buffer.init(this->instance);
+        instance_buffer.create_buffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        uint32_t draw_count = GPU_DRIVEN? MAX_INSTANCES : 1;
+
+        size = sizeof(IndirectDrawStruct) * draw_count;
+        draw_buffer.init(this->instance);
+        draw_buffer.create_buffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        size = sizeof(VkDrawIndexedIndirectCommand) * draw_count;
+        indirect_buffer.init(this->instance);
+        indirect_buffer.create_buffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        size = sizeof(uint32_t) * 2 * (1 + MAX_SWAPCHAIN_IMAGES); // host visible for statistics
+        count_buffer.init(this->instance);
+        count_buffer.create_buffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        counts = reinterpret_cast<uint32_t*>(count_buffer.map());
+        std::memset(counts, 0, (size_t)size);
+
+        size = DYNAMIC_DESCRIPTOR_SIZE * MAX_OBJECTS; // sizeof(Material) * MAX_OBJECTS is smaller
+        material_buffer.init(this->instance);
+        material_buffer.create_buffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        size = sizeof(UniformCullingStruct);
+        culling_buffer.init(this->instance);
+        culling_buffer.create_buffer(size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
     
         printf("created uniform buffers \n");
     }
@@ -150,6 +194,19 @@ public:
         dbi2.offset = 0;
         dbi2.range = DYNAMIC_DESCRIPTOR_SIZE; // sizeof(Material);
 
+        VkDescriptorBufferInfo dbi8 = {}; // instances
+        dbi8.buffer = instance_buffer.buffer;
+        dbi8.offset = 0;
+        dbi8.range = VK_WHOLE_SIZE;
+
+        // draws, commands, counts, materials (storage), culling (uniform)
+        std::array<VkDescriptorBufferInfo, 5> gpu_infos = {};
+        gpu_infos[0] = { draw_buffer.buffer, 0, VK_WHOLE_SIZE };
+        gpu_infos[1] = { indirect_buffer.buffer, 0, VK_WHOLE_SIZE };
+        gpu_infos[2] = { count_buffer.buffer, 0, sizeof(uint32_t) * 2 }; // live counts, slots after them are copies
+        gpu_infos[3] = { material_buffer.buffer, 0, VK_WHOLE_SIZE };
+        gpu_infos[4] = { culling_buffer.buffer, 0, sizeof(UniformCullingStruct) };
+
         VkDescriptorImageInfo enviroment_info = {}; // enviroment
         enviroment_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
         enviroment_info.imageView = enviroment->image_view;
@@ -181,7 +238,7 @@ public:
 
         //---------------------------------------------------------
 
-        std::array<VkWriteDescriptorSet, 8> descriptorWrites = {};
+        std::array<VkWriteDescriptorSet, 14> descriptorWrites = {};
 
         descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; // view
         descriptorWrites[0].dstSet = descriptor_sets;
@@ -246,6 +303,24 @@ public:
         descriptorWrites[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         descriptorWrites[7].descriptorCount = MAX_IMAGES; 
         descriptorWrites[7].pImageInfo = emission_info;
+
+        descriptorWrites[8].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; // instances
+        descriptorWrites[8].dstSet = descriptor_sets;
+        descriptorWrites[8].dstBinding = 8;
+        descriptorWrites[8].dstArrayElement = 0;
+        descriptorWrites[8].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[8].descriptorCount = 1;
+        descriptorWrites[8].pBufferInfo = &dbi8;
+
+        for(uint32_t i = 0; i < gpu_infos.size(); i++){ // draws, commands, counts, materials, culling
+            descriptorWrites[9 + i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[9 + i].dstSet = descriptor_sets;
+            descriptorWrites[9 + i].dstBinding = 9 + i;
+            descriptorWrites[9 + i].dstArrayElement = 0;
+            descriptorWrites[9 + i].descriptorType = i == 4? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[9 + i].descriptorCount = 1;
+            descriptorWrites[9 + i].pBufferInfo = &gpu_infos[i];
+        }
         
 
         //---------------------------------------------------------
@@ -289,8 +364,8 @@ private:
 
     void create_descriptor_set_layout()
     {
-        // view, properties, mesh, enviroment, albedo, normal, material, emission
-        std::array<VkDescriptorSetLayoutBinding, 8> bindings;
+        // view, properties, mesh, enviroment, albedo, normal, material, emission, instances, draws, commands, counts, materials, culling
+        std::array<VkDescriptorSetLayoutBinding, 14> bindings;
         for(uint32_t i =0; i < bindings.size(); i++) bindings[i] = {};
 
         bindings[0].binding = 0; // view
@@ -335,6 +410,36 @@ private:
         bindings[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         bindings[7].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
+        bindings[8].binding = 8; // instances
+        bindings[8].descriptorCount = 1;
+        bindings[8].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[8].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+        bindings[9].binding = 9; // draws, vertex shader reads material slot
+        bindings[9].descriptorCount = 1;
+        bindings[9].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[9].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+
+        bindings[10].binding = 10; // indirect commands
+        bindings[10].descriptorCount = 1;
+        bindings[10].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[10].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        bindings[11].binding = 11; // draw counts
+        bindings[11].descriptorCount = 1;
+        bindings[11].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[11].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        bindings[12].binding = 12; // materials
+        bindings[12].descriptorCount = 1;
+        bindings[12].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[12].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        bindings[13].binding = 13; // culling
+        bindings[13].descriptorCount = 1;
+        bindings[13].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        bindings[13].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
         VkDescriptorSetLayoutCreateInfo ci = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
         ci.bindingCount = (uint32_t)bindings.size();
         ci.pBindings = bindings.data();
@@ -349,7 +454,7 @@ private:
 
     void create_descriptor_pool()
     {
-        std::array<VkDescriptorPoolSize, 8> pool_sizes = {};
+        std::array<VkDescriptorPoolSize, 11> pool_sizes = {};
         pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; // view
         pool_sizes[0].descriptorCount = 1;
         pool_sizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; // properties
@@ -367,6 +472,12 @@ private:
         pool_sizes[6].descriptorCount = 1;
         pool_sizes[7].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; // emission
         pool_sizes[7].descriptorCount = 1;
+        pool_sizes[8].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; // instances
+        pool_sizes[8].descriptorCount = 1;
+        pool_sizes[9].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; // draws, commands, counts, materials
+        pool_sizes[9].descriptorCount = 4;
+        pool_sizes[10].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; // culling
+        pool_sizes[10].descriptorCount = 1;
         
 
         VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
@@ -0,0 +1,174 @@
+#pragma once
+#include "common.hpp"
+
+//-------------------------------------------------------------------
+/// Compact glTF tables, built once from json so mesh extraction doesn't touch json
+
+namespace gltf
+{
+    enum class ComponentType : uint32_t {
+        BYTE = 5120,
+        UNSIGNED_BYTE = 5121,
+        SHORT = 5122,
+        UNSIGNED_SHORT = 5123,
+        UNSIGNED_INT = 5125,
+        FLOAT = 5126,
+    };
+
+    enum class AccessorType : uint32_t { SCALAR, VEC2, VEC3, VEC4, MAT2, MAT3, MAT4 };
+
+    /// byte size of single component
+    uint32_t component_size(ComponentType type)
+    {
+        switch(type){
+            case ComponentType::BYTE:
+            case ComponentType::UNSIGNED_BYTE:  return 1;
+            case ComponentType::SHORT:
+            case ComponentType::UNSIGNED_SHORT: return 2;
+            case ComponentType::UNSIGNED_INT:
+            case ComponentType::FLOAT:          return 4;
+        }
+        throw std::runtime_error("unknown accessor component type");
+    }
+
+    /// amount of components in element
+    uint32_t component_count(AccessorType type)
+    {
+        switch(type){
+            case AccessorType::SCALAR: return 1;
+            case AccessorType::VEC2:   return 2;
+            case AccessorType::VEC3:   return 3;
+            case AccessorType::VEC4:   return 4;
+            case AccessorType::MAT2:   return 4;
+            case AccessorType::MAT3:   return 9;
+            case AccessorType::MAT4:   return 16;
+        }
+        throw std::runtime_error("unknown accessor type");
+    }
+
+    /// integer component to float, normalized integers map to [0, 1] or [-1, 1] (KHR_mesh_quantization)
+    float dequantize(float value, ComponentType type, bool normalized)
+    {
+        if(!normalized) return value;
+        switch(type){
+            case ComponentType::BYTE:           return std::max(value / 127.0f, -1.0f);
+            case ComponentType::UNSIGNED_BYTE:  return value / 255.0f;
+            case ComponentType::SHORT:          return std::max(value / 32767.0f, -1.0f);
+            case ComponentType::UNSIGNED_SHORT: return value / 65535.0f;
+            default:                            return value;
+        }
+    }
+
+    AccessorType to_accessor_type(const std::string& type)
+    {
+        if(type == "SCALAR") return AccessorType::SCALAR;
+        if(type == "VEC2") return AccessorType::VEC2;
+        if(type == "VEC3") return AccessorType::VEC3;
+        if(type == "VEC4") return AccessorType::VEC4;
+        if(type == "MAT2") return AccessorType::MAT2;
+        if(type == "MAT3") return AccessorType::MAT3;
+        if(type == "MAT4") return AccessorType::MAT4;
+        throw std::runtime_error("unknown accessor type: " + type);
+    }
+
+    //---------------------------------------
+
+    struct Buffer{
+        std::string uri; // external file or data uri, empty - GLB binary chunk
+        uint32_t length = 0;
+    };
+
+    struct BufferView{
+        uint32_t buffer = 0;
+        uint32_t offset = 0;
+        uint32_t length = 0;
+        uint32_t stride = 0; // 0 - elements are tightly packed
+    };
+
+    struct Accessor{
+        int32_t buffer_view = -1;
+        uint32_t offset = 0;
+        uint32_t count = 0;
+        ComponentType component_type = ComponentType::FLOAT;
+        AccessorType type = AccessorType::SCALAR;
+        bool normalized = false;
+
+        bool has_bounds = false; // min/max of first 3 components
+        glm::vec3 min = glm::vec3(0);
+        glm::vec3 max = glm::vec3(0);
+
+        struct Sparse{ // only `count` elements replace base view (or zeros without base view)
+            uint32_t count = 0;
+            uint32_t indices_view = 0;
+            uint32_t indices_offset = 0;
+            ComponentType indices_type = ComponentType::UNSIGNED_INT;
+            uint32_t values_view = 0;
+            uint32_t values_offset = 0;
+        } sparse;
+
+        uint32_t element_size() const { return component_size(component_type) * component_count(type); }
+    };
+
+    struct Image{
+        std::string uri; // external file
+        int32_t buffer_view = -1; // or embedded image
+    };
+
+    struct Material{
+        std::string name = "material";
+
+        // texture indices, -1 means no texture
+        int32_t albedo_texture = -1;
+        int32_t normal_texture = -1;
+        int32_t material_texture = -1;
+        int32_t emission_texture = -1;
+
+        // defaults match mesh uniform
+        glm::vec3 base_color = glm::vec3(1.0);
+        glm::vec3 emission_factor = glm::vec3(1.0);
+        float roughness = 1.0;
+        float metalliness = 1.0;
+        bool double_sided = false;
+    };
+
+    struct Primitive{ // accessor indices, -1 means missing
+        int32_t position = -1;
+        int32_t normal = -1;
+        int32_t texcoord = -1;
+        int32_t tangent = -1;
+        int32_t indices = -1;
+        int32_t material = -1;
+    };
+
+    struct Mesh{
+        std::string name;
+        bool has_name = false;
+        std::vector<Primitive> primitives;
+    };
+
+    struct Node{
+        std::string name = "node";
+        glm::mat4 cframe = glm::mat4(1.0);
+        int32_t mesh = -1;
+        std::vector<uint32_t> children;
+
+        // EXT_mesh_gpu_instancing accessors, -1 means missing
+        int32_t instance_translation = -1;
+        int32_t instance_rotation = -1;
+        int32_t instance_scale = -1;
+    };
+
+    struct Tables{
+        std::vector<Buffer> buffers;
+        std::vector<BufferView> buffer_views;
+        std::vector<Accessor> accessors;
+        std::vector<uint32_t> textures; // texture -> image index
+        std::vector<Image> images;
+        std::vector<Material> materials;
+        std::vector<Mesh> meshes;
+        std::vector<Node> nodes;
+        std::vector<uint32_t> scene; // root nodes
+
+        void clear(){ *this = Tables(); }
+    };
+}
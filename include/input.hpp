@@ -10,6 +10,7 @@ namespace Input
         bool S = false;
         bool D = false;
         bool L = false;
+        bool R = false;
         bool Minus = false;
         bool Equal = false;
     }
@@ -64,6 +65,7 @@ namespace Input
             if(key == GLFW_KEY_S) Input::Keys::S = true;
             if(key == GLFW_KEY_D) Input::Keys::D = true;
             if(key == GLFW_KEY_L) Input::Keys::L = true;
+            if(key == GLFW_KEY_R) Input::Keys::R = true;
 
             if(key == GLFW_KEY_MINUS) Input::Keys::Minus = true;
             if(key == GLFW_KEY_EQUAL) Input::Keys::Equal = true;
@@ -81,6 +83,7 @@ namespace Input
             if(key == GLFW_KEY_S) Input::Keys::S = false;
             if(key == GLFW_KEY_D) Input::Keys::D = false;
             if(key == GLFW_KEY_L) Input::Keys::L = false;
+            if(key == GLFW_KEY_R) Input::Keys::R = false;
 
             if(key == GLFW_KEY_MINUS) Input::Keys::Minus = false;
             if(key == GLFW_KEY_EQUAL) Input::Keys::Equal = false;
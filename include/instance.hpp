@@ -33,6 +33,8 @@ public:
     VkDevice device;
     VkPhysicalDevice physical_device;
     VkCommandPool transfer_command_pool;
+    std::mutex queue_mutex; // all queues are the same VkQueue, shared by render and loader threads
+    PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count = nullptr; // VK_KHR_draw_indirect_count, only with GPU_DRIVEN
     
     Queues queues = {};
     Surface surface = {};
@@ -68,7 +70,10 @@ public:
         allocInfo.commandBufferCount = 1;
 
         VkCommandBuffer commandBuffer;
-        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+        }
 
         VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
         beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
@@ -85,12 +90,29 @@ public:
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffer;
 
-        vkQueueSubmit(queues.transfer_queue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(queues.transfer_queue);
+        // wait on fence instead of queue, so render thread can keep submitting
+        VkFenceCreateInfo fenceInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+        VkFence fence;
+        vkCreateFence(device, &fenceInfo, nullptr, &fence);
+
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            vkQueueSubmit(queues.transfer_queue, 1, &submitInfo, fence);
+        }
+        vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+        vkDestroyFence(device, fence, nullptr);
 
+        std::lock_guard<std::mutex> lock(queue_mutex);
         vkFreeCommandBuffers(device, transfer_command_pool, 1, &commandBuffer);
     }
 
+    /// `vkDeviceWaitIdle` requires every queue to be externally synchronized
+    void wait_idle()
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        vkDeviceWaitIdle(device);
+    }
+
 private:
 
     //------------------------------------------------------------------------------------------------------------------------------
@@ -240,14 +262,31 @@ private:
         VkPhysicalDeviceFeatures device_features = {};
         device_features.samplerAnisotropy = VK_TRUE;
 
+        // indirect draws: many commands per call, firstInstance selects instance transform
+        std::vector<const char*> extensions = DEVICE_EXTENSIONS;
+        bool has_indirect_count = false;
+        if(GPU_DRIVEN){
+            VkPhysicalDeviceFeatures supported = {};
+            vkGetPhysicalDeviceFeatures(this->physical_device, &supported);
+            if(supported.multiDrawIndirect && supported.drawIndirectFirstInstance){
+                device_features.multiDrawIndirect = VK_TRUE;
+                device_features.drawIndirectFirstInstance = VK_TRUE;
+                has_indirect_count = is_device_extension_supported(this->physical_device, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+                if(has_indirect_count) extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            }else{
+                msg::warn("multiDrawIndirect is not supported, GPU driven rendering is disabled");
+                GPU_DRIVEN = false;
+            }
+        }
+
         // create logical device with queues
         VkDeviceCreateInfo ci = {};
         ci.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
         ci.pEnabledFeatures = &device_features;
         ci.queueCreateInfoCount = (uint32_t)queue_create_infos.size();
         ci.pQueueCreateInfos = queue_create_infos.data();
-        ci.enabledExtensionCount = (uint32_t)DEVICE_EXTENSIONS.size();
-        ci.ppEnabledExtensionNames = DEVICE_EXTENSIONS.data();
+        ci.enabledExtensionCount = (uint32_t)extensions.size();
+        ci.ppEnabledExtensionNames = extensions.data();
 
         if(vkCreateDevice(this->physical_device, &ci, nullptr, &this->device) == VK_SUCCESS){
             printf("Created logical device \n");
@@ -255,6 +294,10 @@ private:
             throw std::runtime_error("failed to create logical device!");
         }
 
+        // without count, culled commands are kept with zero instances
+        if(has_indirect_count) draw_indexed_indirect_count = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(this->device, "vkCmdDrawIndexedIndirectCountKHR");
+        if(GPU_DRIVEN) msg::printl("GPU driven rendering, indirect count: ", draw_indexed_indirect_count != nullptr);
+
         // get queues from logical device
         vkGetDeviceQueue(this->device, this->queues.graphics_family_index, 0, &this->queues.graphics_queue);
         vkGetDeviceQueue(this->device, this->queues.present_family_index,  0, &this->queues.present_queue);
@@ -343,6 +386,20 @@ private:
         return is_supported;
     }
 
+    bool is_device_extension_supported(const VkPhysicalDevice &physical_device, const char* extension_name)
+    {
+        uint32_t extension_count = 0;
+        vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr);
+
+        std::vector<VkExtensionProperties> available_extensions(extension_count);
+        vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, available_extensions.data());
+
+        for(const VkExtensionProperties &available_extension : available_extensions){
+            if(std::strcmp(extension_name, available_extension.extensionName) == 0) return true;
+        }
+        return false;
+    }
+
     bool is_device_surface_capable(const VkPhysicalDevice& physical_device)
     {
         uint32_t count;
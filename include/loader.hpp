@@ -1,5 +1,12 @@
 #pragma once
 #include "common.hpp"
+#include "gltf.hpp"
+#include "simd.hpp"
+#include "cache.hpp"
+#include "tangents.hpp"
+#include "optimizer.hpp"
+#include "simplifier.hpp"
+#include "meshlets.hpp"
 
 class Loader{
     using json = nlohmann::json;
@@ -8,15 +15,45 @@ private:
     enum TYPE { GLB, GLTF };
 
     json content; // json chunk
-    std::vector<char> buffer; // binary chunk
+    gltf::Tables tables; // compact copy of json chunk
+    MappedFile mapping; // memory mapped .glb file
+    const char* binary_chunk = nullptr; // GLB binary chunk (view into `mapping`)
+    size_t binary_chunk_size = 0;
     std::string name; // for glTF
     std::string folder;
     TYPE type;
+    ModelCache cache;
+
+    struct TextureSource{ // where to decode texture from
+        std::string path; // glTF image file
+        const char* data = nullptr; // or image embedded in binary chunk
+        uint32_t length = 0;
+    };
+
+    std::vector<std::shared_ptr<const std::vector<uint8_t>>> image_pixels; // decoded once per image, shared by meshes
+    std::thread texture_thread; // decodes textures while geometry is extracted
+    std::exception_ptr texture_error = nullptr;
+
+    struct BufferData{ // glTF buffer, loaded on first access
+        bool loaded = false;
+        const char* data = nullptr;
+        size_t size = 0;
+        std::unique_ptr<MappedFile> file; // external .bin file
+        std::vector<char> bytes; // decoded data uri
+    };
+
+    std::vector<BufferData> buffers; // same order as `tables.buffers`
 
     struct MemoryInfo{ // get buffer binary data offset/size/stride 
+        uint32_t accessor;
+        const char* data; // first element, nullptr - accessor without buffer view (zeros)
         uint32_t offset;
-        uint32_t stride;
-        uint32_t length;
+        uint32_t stride; // bytes between elements (bufferView byteStride)
+        uint32_t size; // element size
+        uint32_t count;
+        gltf::ComponentType component_type;
+        uint32_t components;
+        bool normalized;
     };
 
     glm::mat4 construct_cframe(glm::vec3 translation, glm::quat rotation, glm::vec3 scale){
@@ -28,23 +65,30 @@ private:
         return matrix;
     }
 
+    std::map<uint32_t, std::vector<std::shared_ptr<Geometry>>> mesh_geometry; // glTF mesh -> geometry of each primitive
+    std::vector<std::shared_ptr<Geometry>> geometries; // unique, in buffer order
+
     struct Counter{
         uint32_t mesh = 0;
         uint32_t indices = 0;
         uint32_t vertices = 0;
-        uint32_t albedo_texture = 0;
-        uint32_t normal_texture = 0;
-        uint32_t material_texture = 0;
-        uint32_t emission_texture = 0;
+        uint64_t extract_time = 0; // microseconds spent in create_indices/create_vertices
+        uint32_t quantized = 0; // primitives with integer attributes
+        std::map<uint32_t, int32_t> albedo_layers; // image index -> texture array layer
+        std::map<uint32_t, int32_t> normal_layers;
+        std::map<uint32_t, int32_t> material_layers;
+        std::map<uint32_t, int32_t> emission_layers;
 
         void reset(){
             this->mesh = 0;
             this->indices = 0;
             this->vertices = 0;
-            this->albedo_texture = 0;
-            this->normal_texture = 0;
-            this->material_texture = 0;
-            this->emission_texture = 0;
+            this->extract_time = 0;
+            this->quantized = 0;
+            this->albedo_layers.clear();
+            this->normal_layers.clear();
+            this->material_layers.clear();
+            this->emission_layers.clear();
         }
     } counter;
 
@@ -53,169 +97,532 @@ private:
     /// Print space 'n' amount of times
     void gap(int n){for(int i=0;i<n;i++)msg::print("  ");}
 
+    /// json value or default if value is missing
+    template<typename TYPE>
+    TYPE get(const json& node, const std::string& value, TYPE fallback){ return is(node, value)? node[value].get<TYPE>() : fallback; }
+
+    glm::vec3 get_vec3(const json& array){ return glm::vec3(array[0].get<float>(), array[1].get<float>(), array[2].get<float>()); }
+
+    //----------------------------------------------------
+    /// convert json into compact tables once, nothing after this reads json
+
+    void create_tables()
+    {
+        tables.clear();
+
+        if(is(content, "buffers")){
+            for(const json& node : content["buffers"]){
+                gltf::Buffer buffer;
+                buffer.uri = get<std::string>(node, "uri", "");
+                buffer.length = node["byteLength"];
+                tables.buffers.push_back(buffer);
+            }
+        }
+
+        if(is(content, "bufferViews")){
+            for(const json& view : content["bufferViews"]){
+                gltf::BufferView buffer_view;
+                buffer_view.buffer = get<uint32_t>(view, "buffer", 0);
+                buffer_view.offset = get<uint32_t>(view, "byteOffset", 0);
+                buffer_view.length = view["byteLength"];
+                buffer_view.stride = get<uint32_t>(view, "byteStride", 0);
+                tables.buffer_views.push_back(buffer_view);
+            }
+        }
+
+        if(is(content, "accessors")){
+            for(const json& node : content["accessors"]){
+                gltf::Accessor accessor;
+                accessor.buffer_view = get<int32_t>(node, "bufferView", -1);
+                accessor.offset = get<uint32_t>(node, "byteOffset", 0);
+                accessor.count = node["count"];
+                accessor.component_type = (gltf::ComponentType)node["componentType"].get<uint32_t>();
+                accessor.type = gltf::to_accessor_type(node["type"]);
+                accessor.normalized = get<bool>(node, "normalized", false);
+
+                if(is(node, "min") && is(node, "max") && node["min"].size() >= 3 && node["max"].size() >= 3){
+                    accessor.has_bounds = true;
+                    accessor.min = get_vec3(node["min"]);
+                    accessor.max = get_vec3(node["max"]);
+
+                    // quantized bounds are stored as integers
+                    for(int i = 0; i < 3; i++){
+                        accessor.min[i] = gltf::dequantize(accessor.min[i], accessor.component_type, accessor.normalized);
+                        accessor.max[i] = gltf::dequantize(accessor.max[i], accessor.component_type, accessor.normalized);
+                    }
+                }
+
+                if(is(node, "sparse")){
+                    const json& sparse = node["sparse"];
+                    accessor.sparse.count = sparse["count"];
+                    accessor.sparse.indices_view = sparse["indices"]["bufferView"];
+                    accessor.sparse.indices_offset = get<uint32_t>(sparse["indices"], "byteOffset", 0);
+                    accessor.sparse.indices_type = (gltf::ComponentType)sparse["indices"]["componentType"].get<uint32_t>();
+                    accessor.sparse.values_view = sparse["values"]["bufferView"];
+                    accessor.sparse.values_offset = get<uint32_t>(sparse["values"], "byteOffset", 0);
+                }
+                tables.accessors.push_back(accessor);
+            }
+        }
+
+        if(is(content, "textures")){
+            for(const json& texture : content["textures"]) tables.textures.push_back(texture["source"]);
+        }
+
+        if(is(content, "images")){
+            for(const json& node : content["images"]){
+                gltf::Image image;
+                image.uri = get<std::string>(node, "uri", "");
+                image.buffer_view = get<int32_t>(node, "bufferView", -1);
+                tables.images.push_back(image);
+            }
+        }
+
+        if(is(content, "materials")){
+            for(const json& node : content["materials"]){
+                gltf::Material material;
+                material.name = get<std::string>(node, "name", "material");
+
+                if(is(node, "pbrMetallicRoughness")){
+                    const json& pbr = node["pbrMetallicRoughness"];
+                    if(is(pbr, "baseColorTexture")) material.albedo_texture = pbr["baseColorTexture"]["index"];
+                    if(is(pbr, "metallicRoughnessTexture")) material.material_texture = pbr["metallicRoughnessTexture"]["index"];
+                    if(is(pbr, "baseColorFactor")) material.base_color = get_vec3(pbr["baseColorFactor"]);
+                    if(is(pbr, "metallicFactor")) material.metalliness = pbr["metallicFactor"];
+                    if(is(pbr, "roughnessFactor")) material.roughness = pbr["roughnessFactor"];
+                }
+
+                if(is(node, "normalTexture")) material.normal_texture = node["normalTexture"]["index"];
+                if(is(node, "emissiveTexture")) material.emission_texture = node["emissiveTexture"]["index"];
+                if(is(node, "emissiveFactor")) material.emission_factor = get_vec3(node["emissiveFactor"]);
+                material.double_sided = get<bool>(node, "doubleSided", false);
+                tables.materials.push_back(material);
+            }
+        }
+
+        if(is(content, "meshes")){
+            for(const json& node : content["meshes"]){
+                gltf::Mesh mesh;
+                mesh.has_name = is(node, "name");
+                mesh.name = get<std::string>(node, "name", "");
+
+                for(const json& primitive_node : node["primitives"]){
+                    gltf::Primitive primitive;
+                    const json& attributes = primitive_node["attributes"];
+                    primitive.position = get<int32_t>(attributes, "POSITION", -1);
+                    primitive.normal = get<int32_t>(attributes, "NORMAL", -1);
+                    primitive.texcoord = get<int32_t>(attributes, "TEXCOORD_0", -1);
+                    primitive.tangent = get<int32_t>(attributes, "TANGENT", -1);
+                    primitive.indices = get<int32_t>(primitive_node, "indices", -1);
+                    primitive.material = get<int32_t>(primitive_node, "material", -1);
+                    mesh.primitives.push_back(primitive);
+                }
+                tables.meshes.push_back(mesh);
+            }
+        }
+
+        if(is(content, "nodes")){
+            for(const json& node : content["nodes"]){
+                gltf::Node model_node;
+
+                if(is(node, "matrix"))
+                {
+                    std::array<float, 16> nums = node["matrix"];
+                    model_node.cframe = glm::make_mat4(nums.data());
+                }
+                else
+                {
+                    glm::vec3 translation = is(node, "translation")? get_vec3(node["translation"]) : glm::vec3(0);
+
+                    glm::quat rotation = is(node, "rotation")? glm::quat( 
+                        node["rotation"][3].get<float>(),
+                        node["rotation"][0].get<float>(),
+                        node["rotation"][1].get<float>(),
+                        node["rotation"][2].get<float>()
+                    ) : glm::quat(1,0,0,0);
+
+                    glm::vec3 scale = is(node, "scale")? get_vec3(node["scale"]) : glm::vec3(1);
+
+                    model_node.cframe = construct_cframe(translation, rotation, scale);
+                }
+
+                model_node.name = get<std::string>(node, "name", "node");
+                model_node.mesh = get<int32_t>(node, "mesh", -1);
+                if(is(node, "children")) model_node.children = node["children"].get<std::vector<uint32_t>>();
+
+                if(is(node, "extensions") && is(node["extensions"], "EXT_mesh_gpu_instancing")){
+                    const json& attributes = node["extensions"]["EXT_mesh_gpu_instancing"]["attributes"];
+                    model_node.instance_translation = get<int32_t>(attributes, "TRANSLATION", -1);
+                    model_node.instance_rotation = get<int32_t>(attributes, "ROTATION", -1);
+                    model_node.instance_scale = get<int32_t>(attributes, "SCALE", -1);
+                }
+                tables.nodes.push_back(model_node);
+            }
+        }
+
+        uint32_t scene = get<uint32_t>(content, "scene", 0);
+        tables.scene = content["scenes"].at(scene)["nodes"].get<std::vector<uint32_t>>();
+
+        // buffers are loaded on first access
+        buffers.clear();
+        buffers.resize(tables.buffers.size());
+    }
+
+    //----------------------------------------------------
+    /// get buffer data, buffer is mapped/decoded the first time an accessor or image reaches it
+
+    const BufferData& get_buffer(uint32_t buffer_id)
+    {
+        const gltf::Buffer& info = tables.buffers.at(buffer_id);
+        BufferData& buffer = buffers.at(buffer_id);
+        if(buffer.loaded) return buffer;
+
+        const std::string data_prefix = "data:";
+        if(info.uri.empty())
+        {
+            if(buffer_id != 0 || binary_chunk == nullptr) throw std::runtime_error("buffer " + std::to_string(buffer_id) + " has no uri");
+            buffer.data = binary_chunk;
+            buffer.size = binary_chunk_size;
+        }
+        else if(info.uri.compare(0, data_prefix.size(), data_prefix) == 0)
+        {
+            std::size_t comma = info.uri.find(',');
+            if(comma == std::string::npos || info.uri.rfind(";base64", comma) == std::string::npos) throw std::runtime_error("buffer " + std::to_string(buffer_id) + " data uri is not base64");
+            buffer.bytes = decode_base64(info.uri.data() + comma + 1, info.uri.size() - comma - 1);
+            buffer.data = buffer.bytes.data();
+            buffer.size = buffer.bytes.size();
+        }
+        else
+        {
+            buffer.file = std::make_unique<MappedFile>();
+            buffer.file->map(folder + info.uri);
+            cache.dependencies.push_back(folder + info.uri);
+            buffer.data = buffer.file->data;
+            buffer.size = buffer.file->size;
+        }
+
+        if(buffer.size < info.length) throw std::runtime_error("buffer " + std::to_string(buffer_id) + " is smaller than byteLength");
+        buffer.loaded = true;
+
+        if(APP_DEBUG) msg::printl("Loaded buffer ", buffer_id, " (", buffer.size, " bytes)");
+        return buffer;
+    }
+
+    /// get bytes of buffer view
+    const char* get_buffer_view_data(const gltf::BufferView& buffer_view, size_t end)
+    {
+        const BufferData& buffer = get_buffer(buffer_view.buffer);
+        if(end > buffer_view.length || (size_t)buffer_view.offset + buffer_view.length > buffer.size) throw std::runtime_error("buffer view is out of buffer bounds");
+        return buffer.data + buffer_view.offset;
+    }
+
     //----------------------------------------------------
     /// get primitive's memory location/size
     
     MemoryInfo get_memory_info(const uint32_t accessor_id)
     {
-        json accessor = content["accessors"][accessor_id];
-
-        std::string type = accessor["type"];
-        uint32_t buffer_view_id = accessor["bufferView"];
-        uint32_t accessor_offset = is(accessor,"byteOffset")? accessor["byteOffset"] : 0;
-
-        json buffer_view = content["bufferViews"][buffer_view_id]; // byteOffset
-
-        uint32_t buffer_offset = is(buffer_view, "byteOffset")? buffer_view["byteOffset"] : 0;
-        //uint32_t buffer_length = is(buffer_view, "byteLength")? buffer_view["byteLength"] : 0;
-        uint32_t stride; // validate if data types are supported by this parser
-
-        //-----------------------------------------------------
-        //if(type == "VEC4"){ stride = 4 * 4; msg::error("vec4");} else  // float = 4 bytes, vec3 = 3 floats
-        if(type == "VEC3") stride = 4 * 3; else  // float = 4 bytes, vec3 = 3 floats
-        if(type == "VEC2") stride = 4 * 2; else
-        if(type == "SCALAR"){ 
-            if(accessor["componentType"] == 5123) stride = 2; else // unsignet short (2 bytes)
-            if(accessor["componentType"] == 5125) stride = 4; else // unsigned int (4 bytes)
-            throw std::runtime_error("nuknown accessor component type");
-        }else throw std::runtime_error("unknown accessor type");
-        //----------------------------------------------------
+        const gltf::Accessor& accessor = tables.accessors.at(accessor_id);
+
+        // component types are validated by attribute (create_indices/create_vertices)
+        if(accessor.type != gltf::AccessorType::SCALAR && accessor.type != gltf::AccessorType::VEC2 && accessor.type != gltf::AccessorType::VEC3 && accessor.type != gltf::AccessorType::VEC4) throw std::runtime_error("unknown accessor type");
+
         MemoryInfo memory = {};
-        memory.offset = buffer_offset + accessor_offset;
-        memory.length = (uint32_t)accessor["count"] * stride; // byte length
-        memory.stride = stride;
+        memory.accessor = accessor_id;
+        memory.data = nullptr;
+        memory.offset = accessor.offset;
+        memory.size = accessor.element_size();
+        memory.stride = memory.size;
+        memory.count = accessor.count;
+        memory.component_type = accessor.component_type;
+        memory.components = gltf::component_count(accessor.type);
+        memory.normalized = accessor.normalized;
+
+        // sparse accessor can be without base data
+        if(accessor.buffer_view == -1){
+            if(accessor.sparse.count == 0) throw std::runtime_error("accessor without buffer view is not supported");
+            return memory;
+        }
+
+        const gltf::BufferView& buffer_view = tables.buffer_views.at(accessor.buffer_view);
+        if(buffer_view.stride != 0) memory.stride = buffer_view.stride;
+
+        // offset/end are relative to buffer view
+        size_t end = memory.count == 0? memory.offset : (size_t)memory.offset + (size_t)(memory.count - 1) * memory.stride + memory.size;
+        memory.data = get_buffer_view_data(buffer_view, end) + memory.offset;
 
         return memory;
     }
 
     //----------------------------------------------------
-    // get min/max
-    Region get_region(const json& primitive)
-    {
-        Region r;
-        try{
-            uint32_t accessor_id = primitive["attributes"]["POSITION"];
-            json accessor = content["accessors"][accessor_id];
+    /// sparse substitution indices of accessor, validated against accessor count
 
-            r.min = glm::vec3( accessor["min"][0], accessor["min"][1], accessor["min"][2]);
-            r.max = glm::vec3( accessor["max"][0], accessor["max"][1], accessor["max"][2]);
-        }catch(const json::exception& e){
-            msg::warn(std::string("Failed to get region: ") + e.what());
+    std::vector<uint32_t> get_sparse_indices(const gltf::Accessor& accessor)
+    {
+        const gltf::Accessor::Sparse& sparse = accessor.sparse;
+        const gltf::BufferView& buffer_view = tables.buffer_views.at(sparse.indices_view);
+        const uint32_t size = gltf::component_size(sparse.indices_type);
+        const char* data = get_buffer_view_data(buffer_view, (size_t)sparse.indices_offset + (size_t)sparse.count * size) + sparse.indices_offset;
+
+        std::vector<uint32_t> indices(sparse.count);
+        switch(sparse.indices_type){
+            case gltf::ComponentType::UNSIGNED_BYTE:  widen_indices(reinterpret_cast<const uint8_t*>(data), indices.data(), sparse.count); break;
+            case gltf::ComponentType::UNSIGNED_SHORT: widen_indices(reinterpret_cast<const uint16_t*>(data), indices.data(), sparse.count); break;
+            case gltf::ComponentType::UNSIGNED_INT:   std::memcpy(indices.data(), data, (size_t)sparse.count * sizeof(uint32_t)); break;
+            default: throw std::runtime_error("unknown sparse index component type");
         }
-        return r;
+
+        for(uint32_t index : indices) if(index >= accessor.count) throw std::runtime_error("sparse index is out of accessor bounds");
+        return indices;
+    }
+
+    /// sparse substitution values of accessor, tightly packed
+    MemoryInfo get_sparse_values(const MemoryInfo& memory)
+    {
+        const gltf::Accessor::Sparse& sparse = tables.accessors.at(memory.accessor).sparse;
+        const gltf::BufferView& buffer_view = tables.buffer_views.at(sparse.values_view);
+
+        MemoryInfo values = memory;
+        values.offset = sparse.values_offset;
+        values.stride = memory.size;
+        values.count = sparse.count;
+        values.data = get_buffer_view_data(buffer_view, (size_t)sparse.values_offset + (size_t)sparse.count * memory.size) + sparse.values_offset;
+        return values;
+    }
+
+    //----------------------------------------------------
+    // get min/max
+    /// POSITION accessor min/max, computed from extracted `vertices` if accessor has none
+    Region get_region(const gltf::Primitive& primitive, const std::vector<Vertex>& vertices)
+    {
+        const gltf::Accessor& accessor = tables.accessors.at(primitive.position);
+        if(accessor.has_bounds) return Region(accessor.min, accessor.max);
+        return get_position_bounds(vertices.data(), vertices.size());
     }
 
     //----------------------------------------------------
     // get vertices
 
-    std::vector<uint32_t> create_indices(const json& primitive)
+    /// indices are checked against `vertex_count` once here, so later passes can index vertices unchecked
+    std::vector<uint32_t> create_indices(const gltf::Primitive& primitive, size_t vertex_count)
     {
-        std::vector<uint32_t> indices;
-
         // mesh can be without indices
-        if(is(primitive,"indices")){
-            uint32_t accessor_id = primitive["indices"];
-            MemoryInfo memory = get_memory_info(accessor_id);
-            indices.resize(memory.length / memory.stride);
+        if(primitive.indices == -1) throw std::runtime_error("Mesh is without indices, indices are required");
+
+        MemoryInfo memory = get_memory_info(primitive.indices);
+        if(memory.components != 1) throw std::runtime_error("indices must be SCALAR");
+        std::vector<uint32_t> indices(memory.count);
+        size_t base_count = memory.data != nullptr? memory.count : 0; // sparse accessor without base view is zeros
+
+        switch(memory.component_type){
+            case gltf::ComponentType::UNSIGNED_BYTE:
+                widen_indices(reinterpret_cast<const uint8_t*>(memory.data), indices.data(), base_count); break;
+            case gltf::ComponentType::UNSIGNED_SHORT:
+                widen_indices(reinterpret_cast<const uint16_t*>(memory.data), indices.data(), base_count); break;
+            case gltf::ComponentType::UNSIGNED_INT:
+                std::memcpy(indices.data(), memory.data, base_count * sizeof(uint32_t)); break;
+            default:
+                throw std::runtime_error("unknown index component type");
+        }
 
-            for(uint32_t i = 0; i < indices.size(); i++){
-                std::memcpy(&indices[i], buffer.data() + memory.offset + i*memory.stride, memory.stride);
-            }
-        }else{
-            throw std::runtime_error("Mesh is without indices, indices are required");
+        // sparse substitutions
+        const gltf::Accessor& accessor = tables.accessors.at(primitive.indices);
+        if(accessor.sparse.count != 0){
+            std::vector<uint32_t> targets = get_sparse_indices(accessor);
+            MemoryInfo values = get_sparse_values(memory);
+            std::vector<uint32_t> replacements(values.count);
+
+            if(memory.component_type == gltf::ComponentType::UNSIGNED_BYTE) widen_indices(reinterpret_cast<const uint8_t*>(values.data), replacements.data(), values.count); else
+            if(memory.component_type == gltf::ComponentType::UNSIGNED_SHORT) widen_indices(reinterpret_cast<const uint16_t*>(values.data), replacements.data(), values.count); else
+            std::memcpy(replacements.data(), values.data, (size_t)values.count * sizeof(uint32_t));
+
+            for(uint32_t i = 0; i < accessor.sparse.count; i++) indices[targets[i]] = replacements[i];
         }
 
+        for(uint32_t index : indices) if(index >= vertex_count) throw std::runtime_error("index is out of vertex range");
         return indices;
     }
 
     //----------------------------------------------------
-    /// get all primitive data and construct vertices
+    /// write accessor elements into float `Vertex` member, integer components are dequantized (KHR_mesh_quantization)
 
-    std::vector<Vertex> create_vertices(const json& primitive)
+    void gather_attribute(const MemoryInfo& memory, Vertex* vertices, size_t member_offset)
     {
-        MemoryInfo memory;
-        uint32_t accessor_id;
+        const bool normalized = memory.normalized;
+        const float lowest = std::numeric_limits<float>::lowest();
 
-        std::vector<glm::vec3> positions;
-        std::vector<glm::vec3> normals;
-        std::vector<glm::vec2> texcoords;
-        
-        //------------------------------------------------
-         
-        accessor_id = primitive["attributes"]["POSITION"];
-        memory = get_memory_info(accessor_id);
-        positions.resize(memory.length / memory.stride);
+        if(memory.data == nullptr){ // sparse accessor without base view
+            for(uint32_t i = 0; i < memory.count; i++) std::memset(reinterpret_cast<char*>(vertices + i) + member_offset, 0, memory.components * sizeof(float));
+            return;
+        }
 
-        for(uint32_t i = 0; i < positions.size(); i++){
-            std::memcpy(&positions[i], buffer.data() + memory.offset + i*memory.stride, memory.stride);
+        switch(memory.component_type){
+            case gltf::ComponentType::FLOAT:
+                if(memory.components == 3) gather_vec3(memory.data, memory.stride, memory.count, vertices, member_offset);
+                else gather_vec2(memory.data, memory.stride, memory.count, vertices, member_offset);
+                break;
+            case gltf::ComponentType::BYTE:
+                gather_dequantized<int8_t>(memory.data, memory.stride, memory.count, memory.components, normalized? 1.0f / 127.0f : 1.0f, normalized? -1.0f : lowest, vertices, member_offset);
+                break;
+            case gltf::ComponentType::UNSIGNED_BYTE:
+                gather_dequantized<uint8_t>(memory.data, memory.stride, memory.count, memory.components, normalized? 1.0f / 255.0f : 1.0f, lowest, vertices, member_offset);
+                break;
+            case gltf::ComponentType::SHORT:
+                gather_dequantized<int16_t>(memory.data, memory.stride, memory.count, memory.components, normalized? 1.0f / 32767.0f : 1.0f, normalized? -1.0f : lowest, vertices, member_offset);
+                break;
+            case gltf::ComponentType::UNSIGNED_SHORT:
+                gather_dequantized<uint16_t>(memory.data, memory.stride, memory.count, memory.components, normalized? 1.0f / 65535.0f : 1.0f, lowest, vertices, member_offset);
+                break;
+            default:
+                throw std::runtime_error("unknown attribute component type");
         }
-        //------------------------------------------------
-        accessor_id = primitive["attributes"]["NORMAL"];
-        memory = get_memory_info(accessor_id);
-        normals.resize(memory.length / memory.stride);
+    }
 
-        
-        for(uint32_t i = 0; i < normals.size(); i++){
-            std::memcpy(&normals[i], buffer.data() + memory.offset + i*memory.stride, memory.stride);
+    /// write accessor (base view, then sparse substitutions in place) into `Vertex` member
+    void write_attribute(const MemoryInfo& memory, std::vector<Vertex>& vertices, size_t member_offset)
+    {
+        gather_attribute(memory, vertices.data(), member_offset);
+
+        const gltf::Accessor& accessor = tables.accessors.at(memory.accessor);
+        if(accessor.sparse.count == 0) return;
+
+        // single pass over sparse elements, untouched base data is never copied again
+        std::vector<uint32_t> indices = get_sparse_indices(accessor);
+        MemoryInfo values = get_sparse_values(memory);
+        values.count = 1;
+
+        for(uint32_t i = 0; i < accessor.sparse.count; i++){
+            gather_attribute(values, &vertices[indices[i]], member_offset);
+            values.data += values.stride;
         }
-        //------------------------------------------------
-        
-        // texcoord is optional
-        if(is(primitive["attributes"],"TEXCOORD_0")){
-            accessor_id = primitive["attributes"]["TEXCOORD_0"];
-            memory = get_memory_info(accessor_id);
-            texcoords.resize(memory.length / memory.stride);
+    }
 
-            for(uint32_t i = 0; i < texcoords.size(); i++){
-                std::memcpy(&texcoords[i], buffer.data() + memory.offset + i*memory.stride, memory.stride);
-            }
+    //----------------------------------------------------
+    /// get all primitive data and write vertices in one pass
+
+    std::vector<Vertex> create_vertices(const gltf::Primitive& primitive)
+    {
+        if(primitive.position == -1) throw std::runtime_error("Mesh is without POSITION attribute");
+        if(primitive.normal == -1) throw std::runtime_error("Mesh is without NORMAL attribute");
+
+        MemoryInfo position = get_memory_info(primitive.position);
+        MemoryInfo normal = get_memory_info(primitive.normal);
+        if(position.components != 3 || normal.components != 3) throw std::runtime_error("POSITION and NORMAL must be VEC3");
+        if(position.count != normal.count) throw std::runtime_error("Vertex primitive data length is not equal.");
+        if(normal.component_type != gltf::ComponentType::FLOAT && !normal.normalized) throw std::runtime_error("quantized NORMAL must be normalized");
+
+        std::vector<Vertex> vertices(position.count);
+        write_attribute(position, vertices, offsetof(Vertex, position));
+        write_attribute(normal, vertices, offsetof(Vertex, normal));
+
+        // texcoord is optional
+        if(primitive.texcoord != -1){
+            MemoryInfo texcoord = get_memory_info(primitive.texcoord);
+            if(texcoord.components != 2) throw std::runtime_error("TEXCOORD_0 must be VEC2");
+            if(texcoord.count != position.count) throw std::runtime_error("Vertex primitive data length is not equal.");
+            write_attribute(texcoord, vertices, offsetof(Vertex, texcoord));
         }else{
-            texcoords.resize(positions.size());
-        }
-        //------------------------------------------------
-        // construct vertices
-        std::vector<Vertex> vertices(positions.size());
-        if(positions.size() == normals.size() && normals.size() == texcoords.size()){
-            for(uint32_t i = 0; i < positions.size(); i++){
-                vertices[i] = Vertex(positions[i], normals[i], texcoords[i]);
+            for(Vertex& vertex : vertices) vertex.texcoord = glm::vec2(0);
+        }
+
+        // tangent is optional (xyz + handedness in w), otherwise generated after extraction
+        if(primitive.tangent != -1){
+            std::vector<float> tangents = read_floats(primitive.tangent, 4);
+            if(tangents.size() != vertices.size() * 4) throw std::runtime_error("Vertex primitive data length is not equal.");
+
+            for(size_t i = 0; i < vertices.size(); i++){
+                const float* tangent = &tangents[i * 4];
+                vertices[i].tangent = glm::make_vec3(tangent);
+                vertices[i].bitangent = glm::cross(vertices[i].normal, vertices[i].tangent) * (tangent[3] < 0? -1.0f : 1.0f);
             }
-        }else{
-            throw std::runtime_error("Vertex primitive data length is not equal.");
         }
 
         return vertices;
     }
+
+    //----------------------------------------------------
+    /// accessor as tightly packed floats, integer components are dequantized
+
+    std::vector<float> read_floats(uint32_t accessor_id, uint32_t components)
+    {
+        MemoryInfo memory = get_memory_info(accessor_id);
+        if(memory.components != components) throw std::runtime_error("unexpected accessor type");
+        const uint32_t component_size = gltf::component_size(memory.component_type);
+
+        auto read_element = [&](const char* element, float* output){
+            for(uint32_t c = 0; c < components; c++){
+                const char* source = element + c * component_size;
+                float value;
+                switch(memory.component_type){
+                    case gltf::ComponentType::FLOAT:          std::memcpy(&value, source, 4); break;
+                    case gltf::ComponentType::BYTE:           value = *reinterpret_cast<const int8_t*>(source); break;
+                    case gltf::ComponentType::UNSIGNED_BYTE:  value = *reinterpret_cast<const uint8_t*>(source); break;
+                    case gltf::ComponentType::SHORT:          { int16_t v; std::memcpy(&v, source, 2); value = v; } break;
+                    case gltf::ComponentType::UNSIGNED_SHORT: { uint16_t v; std::memcpy(&v, source, 2); value = v; } break;
+                    default: throw std::runtime_error("unknown accessor component type");
+                }
+                output[c] = gltf::dequantize(value, memory.component_type, memory.normalized);
+            }
+        };
+
+        std::vector<float> values((size_t)memory.count * components, 0.0f);
+        if(memory.data != nullptr){
+            for(uint32_t i = 0; i < memory.count; i++) read_element(memory.data + (size_t)i * memory.stride, &values[(size_t)i * components]);
+        }
+
+        const gltf::Accessor& accessor = tables.accessors.at(accessor_id);
+        if(accessor.sparse.count != 0){
+            std::vector<uint32_t> indices = get_sparse_indices(accessor);
+            MemoryInfo sparse = get_sparse_values(memory);
+            for(uint32_t i = 0; i < sparse.count; i++) read_element(sparse.data + (size_t)i * sparse.stride, &values[(size_t)indices[i] * components]);
+        }
+        return values;
+    }
+
+    /// EXT_mesh_gpu_instancing transforms of node, empty if node is not instanced
+    std::vector<glm::mat4> create_instances(const gltf::Node& node)
+    {
+        std::vector<float> translations, rotations, scales;
+        if(node.instance_translation != -1) translations = read_floats(node.instance_translation, 3);
+        if(node.instance_rotation != -1) rotations = read_floats(node.instance_rotation, 4);
+        if(node.instance_scale != -1) scales = read_floats(node.instance_scale, 3);
+
+        size_t count = std::max({translations.size() / 3, rotations.size() / 4, scales.size() / 3});
+        if((!translations.empty() && translations.size() != count * 3) || (!rotations.empty() && rotations.size() != count * 4) || (!scales.empty() && scales.size() != count * 3)){
+            throw std::runtime_error("instance attribute length is not equal");
+        }
+
+        std::vector<glm::mat4> instances(count);
+        for(size_t i = 0; i < count; i++){
+            glm::vec3 translation = translations.empty()? glm::vec3(0) : glm::make_vec3(&translations[i * 3]);
+            glm::quat rotation = rotations.empty()? glm::quat(1,0,0,0) : glm::quat(rotations[i*4 + 3], rotations[i*4 + 0], rotations[i*4 + 1], rotations[i*4 + 2]);
+            glm::vec3 scale = scales.empty()? glm::vec3(1) : glm::make_vec3(&scales[i * 3]);
+            instances[i] = construct_cframe(translation, rotation, scale);
+        }
+        return instances;
+    }
     
 
     //----------------------------------------------------
-    /// get primitive's texture pixel data
+    /// decode texture and resize it to `MAX_IMAGE_SIZE`, safe to call from worker threads
 
-    std::vector<uint8_t> get_texture_pixels(uint32_t texture_index)
+    std::vector<uint8_t> get_texture_pixels(const TextureSource& source)
     {
         int width = 0, height = 0, channel = 0;
         stbi_uc* pixels;
 
-        uint32_t source_index = content["textures"][texture_index]["source"];
-        json image = content["images"][source_index];
-
-        if(this->type == TYPE::GLB)
-        {
-            json buffer_view = content["bufferViews"][(uint32_t)image["bufferView"]];
-            uint32_t byte_length = buffer_view["byteLength"];
-            uint32_t byte_offset = is(buffer_view,"byteOffset")? buffer_view["byteOffset"] : 0;
-
+        if(source.data != nullptr){
             pixels = stbi_load_from_memory( 
-                reinterpret_cast<const stbi_uc*>(buffer.data()) + byte_offset, 
-                byte_length,
+                reinterpret_cast<const stbi_uc*>(source.data), 
+                source.length,
                 &width, &height, &channel,
                 STBI_rgb_alpha
             );
-        }else if(this->type == TYPE::GLTF)
-        {
-            std::string uri = image["uri"];
-            pixels = stbi_load((this->folder + uri).c_str(), &width, &height, &channel, STBI_rgb_alpha);
+        }else{
+            pixels = stbi_load(source.path.c_str(), &width, &height, &channel, STBI_rgb_alpha);
         }
 
+        if(!pixels) throw std::runtime_error(std::string("failed to load texture image: ") + source.path);
+
         // resize and write to pixel buffer
         std::vector<uint8_t> pixel_buffer(MAX_IMAGE_SIZE * MAX_IMAGE_SIZE * 4);
         stbir_resize_uint8(pixels, width , height , 0, (uint8_t*)pixel_buffer.data(), MAX_IMAGE_SIZE, MAX_IMAGE_SIZE, 0, 4);
@@ -224,96 +631,234 @@ private:
     } 
 
     //----------------------------------------------------
+    /// images used by materials of meshes reachable from scene, unused images (and their buffers) are never touched
 
-    void fill_material_data(uint32_t material_id, Mesh& mesh, int depth = 0)
+    std::set<uint32_t> collect_scene_images()
+    {
+        std::set<uint32_t> images;
+        std::vector<bool> visited(tables.nodes.size(), false);
+        std::vector<uint32_t> stack(tables.scene.rbegin(), tables.scene.rend());
+
+        auto add_texture = [&](int32_t texture){ if(texture != -1) images.insert(tables.textures.at(texture)); };
+
+        while(!stack.empty()){
+            uint32_t node_id = stack.back(); stack.pop_back();
+            if(visited.at(node_id)) continue;
+            visited[node_id] = true;
+
+            const gltf::Node& node = tables.nodes[node_id];
+            stack.insert(stack.end(), node.children.begin(), node.children.end());
+            if(node.mesh == -1) continue;
+
+            for(const gltf::Primitive& primitive : tables.meshes.at(node.mesh).primitives){
+                if(primitive.material == -1) continue;
+                const gltf::Material& material = tables.materials.at(primitive.material);
+                add_texture(material.albedo_texture);
+                add_texture(material.normal_texture);
+                add_texture(material.material_texture);
+                add_texture(material.emission_texture);
+            }
+        }
+        return images;
+    }
+
+    //----------------------------------------------------
+    /// start decoding every referenced image on worker threads, runs in background while nodes are built
+
+    void decode_textures()
     {
-        json material = content["materials"][material_id];
-        gap(depth); msg::printl(material["name"]);
+        image_pixels.clear();
+        image_pixels.resize(tables.images.size());
+
+        // each image is decoded once, even if multiple textures use it
+        std::set<uint32_t> image_indices = collect_scene_images();
 
-        if(is(material,"pbrMetallicRoughness")){
-            json pbr = material["pbrMetallicRoughness"];
+        // resolve image locations before starting workers
+        std::vector<std::pair<uint32_t, TextureSource>> sources;
+        for(uint32_t image_index : image_indices){
+            TextureSource source;
+            const gltf::Image& image = tables.images.at(image_index);
 
-            // PBR textures
-            if(is(pbr,"baseColorTexture")){
-                uint32_t texture_index = pbr["baseColorTexture"]["index"];
-                mesh.pixels.albedo = get_texture_pixels(texture_index);
-                mesh.uniform.albedo_id = counter.albedo_texture++;
+            if(image.buffer_view != -1)
+            {
+                const gltf::BufferView& buffer_view = tables.buffer_views.at(image.buffer_view);
+
+                source.path = "image " + std::to_string(image_index);
+                source.data = get_buffer_view_data(buffer_view, buffer_view.length);
+                source.length = buffer_view.length;
+            }else
+            {
+                source.path = this->folder + image.uri;
+                cache.dependencies.push_back(source.path);
             }
+            sources.push_back({image_index, source});
+        }
 
-            if(is(pbr,"metallicRoughnessTexture")){
-                uint32_t texture_index = pbr["metallicRoughnessTexture"]["index"];
-                mesh.pixels.material = get_texture_pixels(texture_index);
-                mesh.uniform.material_id = counter.material_texture++;
+        texture_thread = std::thread([this, sources](){
+            try{
+                parallel_for((uint32_t)sources.size(), [&](uint32_t i){
+                    image_pixels[sources[i].first] = std::make_shared<const std::vector<uint8_t>>(get_texture_pixels(sources[i].second));
+                });
+            }catch(...){
+                texture_error = std::current_exception();
             }
+        });
+    }
 
-            // PBR factors
-            if(is(pbr,"baseColorFactor")) mesh.uniform.base_color = glm::vec3(pbr["baseColorFactor"][0], pbr["baseColorFactor"][1], pbr["baseColorFactor"][2]);
-            if(is(pbr,"metallicFactor"))  mesh.uniform.metalliness = pbr["metallicFactor"];
-            if(is(pbr,"roughnessFactor")) mesh.uniform.roughness = pbr["roughnessFactor"];
-            
+    /// wait for texture workers, rethrow decode errors
+    void wait_textures()
+    {
+        if(texture_thread.joinable()) texture_thread.join();
+        if(texture_error){
+            std::exception_ptr error = texture_error;
+            texture_error = nullptr;
+            std::rethrow_exception(error);
         }
+    }
 
-        if(is(material,"normalTexture")){
-            uint32_t texture_index = material["normalTexture"]["index"];
-            mesh.pixels.normal = get_texture_pixels(texture_index);
-            mesh.uniform.normal_id = counter.normal_texture++;
+    /// share decoded pixels with meshes in node order, so result doesn't depend on decode order
+    void fill_texture_pixels(std::vector<Node>& nodes)
+    {
+        for(Node& node : nodes){
+            for(Mesh& mesh : node.meshes){
+                if(mesh.textures.albedo != -1) mesh.pixels.albedo = image_pixels.at(mesh.textures.albedo);
+                if(mesh.textures.normal != -1) mesh.pixels.normal = image_pixels.at(mesh.textures.normal);
+                if(mesh.textures.material != -1) mesh.pixels.material = image_pixels.at(mesh.textures.material);
+                if(mesh.textures.emission != -1) mesh.pixels.emission = image_pixels.at(mesh.textures.emission);
+            }
+            fill_texture_pixels(node.children);
         }
+    }
+
+    /// texture array layer of image, same image in same slot reuses its layer
+    int32_t get_texture_layer(std::map<uint32_t, int32_t>& layers, uint32_t texture_index)
+    {
+        uint32_t image_index = tables.textures.at(texture_index);
+
+        auto layer = layers.find(image_index);
+        if(layer != layers.end()) return layer->second;
 
-        if(is(material,"emissiveTexture")){
-            uint32_t texture_index = material["emissiveTexture"]["index"];
-            mesh.pixels.emission = get_texture_pixels(texture_index);
-            mesh.uniform.emission_id = counter.emission_texture++;
+        if(layers.size() >= MAX_IMAGES){
+            msg::warn("Texture limit reached, image is not used: ", image_index);
+            return -1;
         }
 
-        if(is(material,"emissiveFactor")){
-            mesh.uniform.emission_factor = glm::vec3(
-                material["emissiveFactor"][0],
-                material["emissiveFactor"][1],
-                material["emissiveFactor"][2]
-            );
+        int32_t id = (int32_t)layers.size();
+        layers[image_index] = id;
+        return id;
+    }
+
+    //----------------------------------------------------
+
+    void fill_material_data(uint32_t material_id, Mesh& mesh, int depth = 0)
+    {
+        const gltf::Material& material = tables.materials.at(material_id);
+        gap(depth); msg::printl(material.name);
+
+        // textures
+        if(material.albedo_texture != -1){
+            mesh.uniform.albedo_id = get_texture_layer(counter.albedo_layers, material.albedo_texture);
+            if(mesh.uniform.albedo_id != -1) mesh.textures.albedo = tables.textures[material.albedo_texture];
+        }
+
+        if(material.material_texture != -1){
+            mesh.uniform.material_id = get_texture_layer(counter.material_layers, material.material_texture);
+            if(mesh.uniform.material_id != -1) mesh.textures.material = tables.textures[material.material_texture];
         }
+
+        if(material.normal_texture != -1){
+            mesh.uniform.normal_id = get_texture_layer(counter.normal_layers, material.normal_texture);
+            if(mesh.uniform.normal_id != -1) mesh.textures.normal = tables.textures[material.normal_texture];
+        }
+
+        if(material.emission_texture != -1){
+            mesh.uniform.emission_id = get_texture_layer(counter.emission_layers, material.emission_texture);
+            if(mesh.uniform.emission_id != -1) mesh.textures.emission = tables.textures[material.emission_texture];
+        }
+
+        // factors
+        mesh.uniform.base_color = material.base_color;
+        mesh.uniform.metalliness = material.metalliness;
+        mesh.uniform.roughness = material.roughness;
+        mesh.uniform.emission_factor = material.emission_factor;
+        mesh.double_sided = material.double_sided;
     }
 
     //----------------------------------------------------
+    /// any vertex attribute is stored as integers (KHR_mesh_quantization)
+
+    bool is_quantized(const gltf::Primitive& primitive)
+    {
+        for(int32_t accessor : {primitive.position, primitive.normal, primitive.texcoord, primitive.tangent}){
+            if(accessor != -1 && tables.accessors.at(accessor).component_type != gltf::ComponentType::FLOAT) return true;
+        }
+        return false;
+    }
+
+    /// geometry of every primitive in mesh, extracted only the first time mesh is referenced
+    const std::vector<std::shared_ptr<Geometry>>& get_mesh_geometry(uint32_t mesh_id)
+    {
+        auto found = mesh_geometry.find(mesh_id);
+        if(found != mesh_geometry.end()) return found->second;
+
+        std::vector<std::shared_ptr<Geometry>>& primitives = mesh_geometry[mesh_id];
+        for(const gltf::Primitive& primitive : tables.meshes.at(mesh_id).primitives)
+        {
+            auto geometry = std::make_shared<Geometry>();
+
+            // vertices, indices
+            uint64_t start_time = timestamp_micro();
+            geometry->vertices = create_vertices(primitive);
+            geometry->indices = create_indices(primitive, geometry->vertices.size());
+            geometry->has_tangents = primitive.tangent != -1;
+            if(is_quantized(primitive)) this->counter.quantized++;
+            geometry->region = get_region(primitive, geometry->vertices);
+            this->counter.extract_time += timestamp_micro() - start_time;
+
+            geometry->ioffset = this->counter.indices;
+            geometry->voffset = this->counter.vertices;
+
+            this->counter.indices += geometry->indices.size();
+            this->counter.vertices += geometry->vertices.size();
+
+            primitives.push_back(geometry);
+            geometries.push_back(geometry);
+        }
+        return primitives;
+    }
 
     std::vector<Mesh> build_meshes(uint32_t mesh_id, uint32_t depth = 0)
     {
         std::vector<Mesh> model_meshes;
-        json mesh = content["meshes"][ mesh_id ];
+        const gltf::Mesh& mesh = tables.meshes.at(mesh_id);
+        const std::vector<std::shared_ptr<Geometry>>& primitive_geometry = get_mesh_geometry(mesh_id);
 
         // primitive
-        for(json primitive : mesh["primitives"])
+        for(uint32_t i = 0; i < mesh.primitives.size(); i++)
         {   
+            const gltf::Primitive& primitive = mesh.primitives[i];
             Mesh model_mesh;
 
-            if(is(mesh, "name")){
-                model_mesh.name = mesh["name"];
+            if(mesh.has_name){
+                model_mesh.name = mesh.name;
                 model_mesh.name += " " + std::to_string(this->counter.mesh);
             } 
 
-            // vertices, indices
-            model_mesh.indices = create_indices(primitive);
-            model_mesh.vertices = create_vertices(primitive);
-            model_mesh.region = get_region(primitive);
-            
+            // same glTF mesh in other nodes reuses geometry, only uniform (cframe, material) is per node
+            model_mesh.geometry = primitive_geometry[i];
+            model_mesh.material = primitive.material;
             model_mesh.id = this->counter.mesh;
-            model_mesh.ioffset = this->counter.indices;
-            model_mesh.voffset = this->counter.vertices;
-
-            this->counter.indices += model_mesh.indices.size();
-            this->counter.vertices += model_mesh.vertices.size();
             
-            gap(depth); msg::success(mesh["name"]," primitive");
+            gap(depth); msg::success(mesh.name," primitive");
 
             // material
-            if(is(primitive, "material"))
+            if(primitive.material != -1)
             {
-                uint32_t material_id = primitive["material"];
-                fill_material_data(material_id, model_mesh ,depth);
+                fill_material_data(primitive.material, model_mesh ,depth);
             } 
 
             this->counter.mesh++;
-            model_meshes.push_back(model_mesh);
+            model_meshes.push_back(std::move(model_mesh));
         } // primitives
 
         return model_meshes;
@@ -321,55 +866,29 @@ private:
     //----------------------------------------------------
     /// Scene is made out of `nodes`, each node can have more nodes as children
 
-    std::vector<Node> build_nodes(const json& nodes, int depth = 0)
+    std::vector<Node> build_nodes(const std::vector<uint32_t>& nodes, int depth = 0)
     {
         std::vector<Node> model_nodes;
         for(uint32_t node_id: nodes)
         {
             Node model_node;
-            json node = content["nodes"][node_id];
+            const gltf::Node& node = tables.nodes.at(node_id);
 
-            if(is(node, "matrix"))
-            {
-                std::array<float, 16> nums = node["matrix"];
-                model_node.cframe = glm::make_mat4(nums.data());
-            }
-            else
-            {
-                glm::vec3 translation = is(node, "translation")? glm::vec3( 
-                    node["translation"][0],
-                    node["translation"][1],
-                    node["translation"][2]
-                ) : glm::vec3(0);
-
-                glm::quat rotation = is(node, "rotation")? glm::quat( 
-                    node["rotation"][3],
-                    node["rotation"][0],
-                    node["rotation"][1],
-                    node["rotation"][2]
-                ) : glm::quat(1,0,0,0);
-
-                glm::vec3 scale = is(node, "scale")? glm::vec3( 
-                    node["scale"][0],
-                    node["scale"][1],
-                    node["scale"][2]
-                ) : glm::vec3(1);
-
-                model_node.cframe = construct_cframe(translation, rotation, scale);
-            }
-
-            model_node.name = is(node,"name")? node["name"] : "node";
+            model_node.cframe = node.cframe;
+            model_node.name = node.name;
             gap(depth); msg::highlight(model_node.name); // debug
 
-            if(is(node,"mesh")){
-                model_node.meshes = build_meshes(node["mesh"], depth+1);
+            if(node.mesh != -1){
+                model_node.meshes = build_meshes(node.mesh, depth+1);
+                model_node.instances = create_instances(node);
+                if(!model_node.instances.empty()){ gap(depth+1); msg::printl(model_node.instances.size(), " instances"); }
             } 
 
-            if(is(node,"children")){
-                model_node.children = build_nodes(node["children"], depth+1);
+            if(!node.children.empty()){
+                model_node.children = build_nodes(node.children, depth+1);
             }
 
-            model_nodes.push_back(model_node);
+            model_nodes.push_back(std::move(model_node));
         } 
         
         return model_nodes;
@@ -384,23 +903,31 @@ private:
         // 0x4E4F534A - JSON chunk type
         // 0x004E4942 - Bin chunk type 
 
-        std::ifstream file(path, std::ifstream::binary);
+        // file is mapped, JSON and BIN chunks are views into mapped memory (no copy)
+        mapping.map(path);
+        const char* file = mapping.data;
+        size_t file_size = mapping.size;
+        size_t position = 0;
+
         uint32_t chunk_length, chunk_type;
-        
+
+        /// read `n` bytes from mapped file, throws if file ends
+        auto read = [&](void* destination, size_t n){
+            if(position + n > file_size) throw std::runtime_error(std::string("file is corrupted: ") + path);
+            std::memcpy(destination, file + position, n);
+            position += n;
+        };
 
         //-------------------------------
         // check if file is valid
-
-        if(!file.is_open()){
-            throw std::runtime_error(std::string("Failed to open: ") + path);
-        }else{
+        {
             uint32_t magic;
             uint32_t version;
             uint32_t length;
 
-            file.read((char*)&magic, 4);
-            file.read((char*)&version, 4);
-            file.read((char*)&length, 4);
+            read(&magic, 4);
+            read(&version, 4);
+            read(&length, 4);
 
             if(0x46546C67 == magic){
                 msg::print(path, " | 'glb", version, "' file format | ", length, " bytes (", (float)length/1024/1024, " MB)\n");
@@ -412,19 +939,18 @@ private:
         //-------------------------------
         // read JSON
 
-        file.read((char*)&chunk_length, 4);
-        file.read((char*)&chunk_type, 4);
+        read(&chunk_length, 4);
+        read(&chunk_type, 4);
 
         if(chunk_type != 0x4E4F534A) throw std::runtime_error(std::string("file is corrupted: ") + path);
-
-        buffer.resize(chunk_length);
-        file.read(buffer.data(), chunk_length);
+        if(position + chunk_length > file_size) throw std::runtime_error(std::string("file is corrupted: ") + path);
 
         try{
-            content = content.parse(buffer);
+            content = json::parse(file + position, file + position + chunk_length);
         }catch(json::exception& e){
             throw e;
         }
+        position += chunk_length;
 
         // output to file for debug
         std::ofstream out("debug.json");
@@ -433,17 +959,22 @@ private:
         //-------------------------------
         // read binary buffers
 
-        file.read((char*)&chunk_length, 4);
-        file.read((char*)&chunk_type, 4);
+        read(&chunk_length, 4);
+        read(&chunk_type, 4);
 
         if(chunk_type != 0x004E4942) throw std::runtime_error(std::string("file is corrupted: ") + path);
+        if(position + chunk_length > file_size) throw std::runtime_error(std::string("file is corrupted: ") + path);
 
-        buffer.resize(chunk_length);
-        file.read(buffer.data(), chunk_length);
-        file.close();
+        this->binary_chunk = file + position;
+        this->binary_chunk_size = chunk_length;
 
         Model model;
-        model.nodes = build_nodes(content["scenes"][0]["nodes"]);
+        create_tables();
+        decode_textures();
+        model.nodes = build_nodes(tables.scene);
+        model.geometries = geometries;
+        wait_textures();
+        fill_texture_pixels(model.nodes);
 
         return model;
     }
@@ -466,17 +997,35 @@ private:
         out << content.dump(4); out.close();
         out.close();
 
-        // read buffer (need multiple buffers)
-        std::string buffer_uri = content["buffers"][0]["uri"];
-        this->buffer = read_file(folder + buffer_uri);
-
         // build meshes
         Model model;
-        model.nodes = build_nodes(content["scenes"][0]["nodes"]);
+        create_tables();
+        decode_textures();
+        model.nodes = build_nodes(tables.scene);
+        model.geometries = geometries;
+        wait_textures();
+        fill_texture_pixels(model.nodes);
 
         return model;
     }
 
+    /// stop texture workers and release mapped file, mesh data is already copied into model
+    void release()
+    {
+        if(texture_thread.joinable()) texture_thread.join();
+        texture_error = nullptr;
+        image_pixels.clear();
+        tables.clear();
+
+        buffers.clear();
+        mesh_geometry.clear();
+        geometries.clear();
+        cache.dependencies.clear();
+        mapping.unmap();
+        this->binary_chunk = nullptr;
+        this->binary_chunk_size = 0;
+    }
+
 public:
 
     Model load(std::string path)
@@ -485,6 +1034,11 @@ public:
         Model model;
         std::string type;
 
+        if(cache.read(path, model)){
+            msg::print("Time to create model: ", (float)(timestamp_milli() - start_time)/1000, "\n");
+            return model;
+        }
+
         try{
             type = path.substr(path.length() - 3);
             if(type == "glb") {
@@ -500,17 +1054,45 @@ public:
 
         }catch(const json::exception& e){
             msg::warn(std::string("Loader: ") + e.what());
+            release();
             return Model();
         }catch(const std::exception& e){
             msg::warn(std::string("Loader: ") + e.what());
+            release();
             return Model();
         };
 
-        // clear
         model.total_indices_size = this->counter.indices;
         model.total_vertices_size = this->counter.vertices;
+        model.quantized = this->counter.quantized > 0;
+        msg::print("Time to extract geometry: ", (float)this->counter.extract_time/1000, " ms (", model.geometries.size(), " unique primitives, ", this->counter.mesh, " meshes)\n");
         this->counter.reset();
 
+        // finished geometry is cached, so repeat open skips everything above
+        uint64_t optimize_time = timestamp_micro();
+        optimize_geometries(model.geometries);
+        msg::print("Time to optimize index order: ", (float)(timestamp_micro() - optimize_time)/1000, " ms\n");
+
+        uint64_t tangent_time = timestamp_micro();
+        generate_tangents(model.geometries);
+        msg::print("Time to generate tangents: ", (float)(timestamp_micro() - tangent_time)/1000, " ms\n");
+
+        uint64_t lod_time = timestamp_micro();
+        Simplifier::build_lods(model.geometries);
+        model.total_indices_size = 0;
+        for(std::shared_ptr<Geometry>& geometry : model.geometries) model.total_indices_size += (uint32_t)geometry->indices.size();
+        msg::print("Time to build LODs: ", (float)(timestamp_micro() - lod_time)/1000, " ms\n");
+
+        uint64_t meshlet_time = timestamp_micro();
+        build_meshlets(model.geometries);
+        msg::print("Time to build meshlets: ", (float)(timestamp_micro() - meshlet_time)/1000, " ms\n");
+
+        for(Node& node : model.nodes) node.get_draw_info(model.infos);
+        if(!model.nodes.empty()) cache.write(path, model);
+
+        // clear
+        release();
+
         msg::print("Time to create model: ", (float)(timestamp_milli() - start_time)/1000, "\n");
         return model;
     }
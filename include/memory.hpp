@@ -6,13 +6,13 @@
 class MemoryObject
 {
 public:
-    VkDeviceMemory memory;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
     
 
     void init(Instance *instance){ this->instance = instance; }
 
 protected:
-    Instance *instance;
+    Instance *instance = nullptr;
 
     uint32_t find_memory_type(uint32_t typeBits, VkMemoryPropertyFlags requiredProperties) 
     {
@@ -35,7 +35,7 @@ protected:
 
 class Buffer : public MemoryObject{
 public:
-    VkBuffer buffer;
+    VkBuffer buffer = VK_NULL_HANDLE;
 
     void create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
     {
@@ -73,7 +73,31 @@ public:
         
     }
 
+    /// map whole buffer, for writing many regions without remapping
+    void* map()
+    {
+        void* data;
+        vkMapMemory(instance->device, this->memory, 0, VK_WHOLE_SIZE, 0, &data);
+        return data;
+    }
+
+    void unmap(){ vkUnmapMemory(instance->device, this->memory); }
+
+    /// copy `size` bytes of `source` (staging buffer) starting at `source_offset` into beginning of this buffer
+    void copy_from(const Buffer& source, VkDeviceSize size, VkDeviceSize source_offset = 0)
+    {
+        VkBufferCopy region = {};
+        region.srcOffset = source_offset;
+        region.dstOffset = 0;
+        region.size = size;
+
+        VkCommandBuffer commandBuffer = this->instance->begin_single_use_command();
+        vkCmdCopyBuffer(commandBuffer, source.buffer, this->buffer, 1, &region);
+        this->instance->end_single_use_command(commandBuffer);
+    }
+
     void destroy(){
+        if(instance == nullptr) return; // never created
         vkFreeMemory(instance->device, memory, nullptr);
         vkDestroyBuffer(instance->device, buffer, nullptr);
     }
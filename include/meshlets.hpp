@@ -0,0 +1,203 @@
+#pragma once
+#include "common.hpp"
+#include "optimizer.hpp"
+
+//-------------------------------------------------------------------
+// Cluster (meshlet) partition of LOD 0 triangles for per-cluster culling.
+// Clusters are grown over connected triangles and stored as consecutive index ranges,
+// so they need no extra index data. Every cluster stores bounding sphere and normal cone,
+// so back-facing (cone) and out-of-frustum (sphere) clusters can be skipped.
+
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+const uint32_t MESHLET_MIN_TRIANGLES = 256; // smaller geometry is drawn whole
+const float MESHLET_NORMAL_WEIGHT = 2.0f; // cone tightness against shared vertices when growing
+const float MESHLET_ISLAND_DOT = 0.8f; // disconnected triangle joins cluster if normal is this close to cluster axis
+
+//-------------------------------------------------------------------
+/// sphere and normal cone of triangles [first_index, first_index + index_count)
+
+void compute_meshlet_bounds(const Geometry& geometry, Meshlet& meshlet)
+{
+    const std::vector<uint32_t>& indices = geometry.indices;
+    const std::vector<Vertex>& vertices = geometry.vertices;
+    uint32_t end = meshlet.first_index + meshlet.index_count;
+
+    // sphere around box center
+    glm::vec3 min = vertices[indices[meshlet.first_index]].position, max = min;
+    for(uint32_t i = meshlet.first_index; i < end; i++){
+        min = glm::min(min, vertices[indices[i]].position);
+        max = glm::max(max, vertices[indices[i]].position);
+    }
+    meshlet.center = (min + max) * 0.5f;
+    meshlet.radius = 0;
+    for(uint32_t i = meshlet.first_index; i < end; i++){
+        meshlet.radius = std::max(meshlet.radius, glm::distance(meshlet.center, vertices[indices[i]].position));
+    }
+
+    // cone, axis is average triangle normal, spread is the widest normal
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.index_count / 3);
+    glm::vec3 axis(0);
+    for(uint32_t t = meshlet.first_index; t < end; t += 3){
+        const glm::vec3& p0 = vertices[indices[t + 0]].position;
+        const glm::vec3& p1 = vertices[indices[t + 1]].position;
+        const glm::vec3& p2 = vertices[indices[t + 2]].position;
+
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if(length <= 0) continue;
+        normals.push_back(normal / length);
+        axis += normal / length;
+    }
+
+    meshlet.cone_axis = glm::vec3(0, 0, 1);
+    meshlet.cone_cutoff = 1.0f; // never culled
+    float axis_length = glm::length(axis);
+    if(axis_length <= 0) return;
+    axis /= axis_length;
+
+    float min_dot = 1.0f;
+    for(const glm::vec3& normal : normals) min_dot = std::min(min_dot, glm::dot(axis, normal));
+    meshlet.cone_axis = axis;
+    if(min_dot > 0.1f) meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot); // sine of normal spread angle
+}
+
+//-------------------------------------------------------------------
+/// grow clusters over shared vertices, triangles that add fewer vertices and face the same way are taken first,
+/// LOD 0 indices are reordered so every cluster is one consecutive range
+
+void build_meshlets(Geometry& geometry)
+{
+    geometry.meshlets.clear();
+    uint32_t index_count = geometry.lods.empty()? (uint32_t)geometry.indices.size() : geometry.lods[0].index_count;
+    if(index_count / 3 < MESHLET_MIN_TRIANGLES || index_count % 3 != 0) return;
+
+    const std::vector<uint32_t>& indices = geometry.indices;
+    size_t vertex_count = geometry.vertices.size();
+    uint32_t triangle_count = index_count / 3;
+
+    // vertex -> triangle adjacency (CSR)
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for(uint32_t i = 0; i < index_count; i++) offsets[indices[i] + 1]++;
+    for(size_t v = 0; v < vertex_count; v++) offsets[v + 1] += offsets[v];
+
+    std::vector<uint32_t> adjacency(index_count);
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for(uint32_t i = 0; i < index_count; i++) adjacency[cursor[indices[i]]++] = i / 3;
+
+    std::vector<glm::vec3> normals(triangle_count);
+    for(uint32_t t = 0; t < triangle_count; t++){
+        const glm::vec3& p0 = geometry.vertices[indices[t*3 + 0]].position;
+        const glm::vec3& p1 = geometry.vertices[indices[t*3 + 1]].position;
+        const glm::vec3& p2 = geometry.vertices[indices[t*3 + 2]].position;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        normals[t] = length > 0? normal / length : glm::vec3(0);
+    }
+
+    std::vector<uint32_t> stamp(vertex_count, UINT32_MAX); // last cluster that used vertex
+    std::vector<uint8_t> emitted(triangle_count, 0);
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> order; // triangles by cluster
+    order.reserve(triangle_count);
+    uint32_t seed = 0;
+
+    while(true)
+    {
+        while(seed < triangle_count && emitted[seed]) seed++;
+        if(seed == triangle_count) break;
+
+        uint32_t id = (uint32_t)geometry.meshlets.size();
+        Meshlet meshlet;
+        meshlet.first_index = (uint32_t)order.size() * 3;
+        uint32_t meshlet_vertices = 0;
+        glm::vec3 axis(0);
+        candidates.assign(1, seed);
+
+        while(meshlet.index_count / 3 < MESHLET_MAX_TRIANGLES)
+        {
+            // best candidate: fewest new vertices, then closest to cluster normal
+            int64_t best = -1;
+            float best_score = FLT_MAX;
+            glm::vec3 direction = glm::length(axis) > 0? glm::normalize(axis) : glm::vec3(0);
+            for(uint32_t triangle : candidates){
+                if(emitted[triangle]) continue;
+                uint32_t added = 0;
+                for(uint32_t k = 0; k < 3; k++) if(stamp[indices[triangle*3 + k]] != id) added++;
+                if(meshlet_vertices + added > MESHLET_MAX_VERTICES) continue;
+
+                float score = added + MESHLET_NORMAL_WEIGHT * (1.0f - glm::dot(normals[triangle], direction));
+                if(score < best_score){
+                    best_score = score;
+                    best = triangle;
+                }
+            }
+            if(best == -1){
+                // island is finished, continue with next triangle in cache order (usually near) if it faces the same way
+                if(!candidates.empty() || meshlet_vertices + 3 > MESHLET_MAX_VERTICES) break;
+                while(seed < triangle_count && emitted[seed]) seed++;
+                if(seed == triangle_count || glm::dot(normals[seed], direction) < MESHLET_ISLAND_DOT) break;
+                candidates.assign(1, seed);
+                continue;
+            }
+
+            uint32_t triangle = (uint32_t)best;
+            emitted[triangle] = 1;
+            order.push_back(triangle);
+            axis += normals[triangle];
+            for(uint32_t k = 0; k < 3; k++){
+                uint32_t vertex = indices[triangle*3 + k];
+                if(stamp[vertex] == id) continue;
+                stamp[vertex] = id;
+                meshlet_vertices++;
+                for(uint32_t i = offsets[vertex]; i < offsets[vertex + 1]; i++) if(!emitted[adjacency[i]]) candidates.push_back(adjacency[i]);
+            }
+            meshlet.index_count += 3;
+
+            // drop emitted candidates, so the list only holds the cluster border
+            candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](uint32_t t){ return emitted[t]; }), candidates.end());
+        }
+
+        geometry.meshlets.push_back(meshlet);
+    }
+
+    std::vector<uint32_t> output(index_count);
+    for(uint32_t t = 0; t < triangle_count; t++) std::copy_n(indices.begin() + order[t] * 3, 3, output.begin() + t * 3);
+    std::copy(output.begin(), output.end(), geometry.indices.begin());
+
+    // growth order jumps around cluster border, so every cluster is reordered for vertex cache on its own vertices
+    std::vector<uint32_t> local(vertex_count, UINT32_MAX), global, cluster, clusters;
+    for(const Meshlet& meshlet : geometry.meshlets)
+    {
+        global.clear();
+        cluster.resize(meshlet.index_count);
+        for(uint32_t i = 0; i < meshlet.index_count; i++){
+            uint32_t& vertex = local[geometry.indices[meshlet.first_index + i]];
+            if(vertex == UINT32_MAX){
+                vertex = (uint32_t)global.size();
+                global.push_back(geometry.indices[meshlet.first_index + i]);
+            }
+            cluster[i] = vertex;
+        }
+
+        cluster = tipsify(cluster, global.size(), VERTEX_CACHE_SIZE, clusters);
+        for(uint32_t i = 0; i < meshlet.index_count; i++) geometry.indices[meshlet.first_index + i] = global[cluster[i]];
+        for(uint32_t vertex : global) local[vertex] = UINT32_MAX;
+    }
+    for(Meshlet& meshlet : geometry.meshlets) compute_meshlet_bounds(geometry, meshlet);
+}
+
+/// clusters of every geometry on worker threads, `moffset` is location in combined model list
+void build_meshlets(std::vector<std::shared_ptr<Geometry>>& geometries)
+{
+    parallel_for((uint32_t)geometries.size(), [&](uint32_t i){ build_meshlets(*geometries[i]); });
+
+    uint32_t count = 0, triangles = 0;
+    for(std::shared_ptr<Geometry>& geometry : geometries){
+        geometry->moffset = count;
+        count += (uint32_t)geometry->meshlets.size();
+        for(const Meshlet& meshlet : geometry->meshlets) triangles += meshlet.index_count / 3;
+    }
+    if(count > 0) msg::printl("Meshlets: ", count, " (", (float)triangles / count, " triangles average)");
+}
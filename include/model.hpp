@@ -1,31 +1,150 @@
 #include "common.hpp"
 #include "descriptors.hpp"
+#include "simd.hpp"
+#include "bvh.hpp"
+
+struct GeometryLod{ // index range of one level of detail
+	uint32_t first_index = 0; // relative to geometry indices
+	uint32_t index_count = 0;
+	float error = 0; // max simplification error relative to geometry size
+};
+
+struct Meshlet{ // cluster of consecutive LOD 0 triangles, bounds are in geometry space
+	glm::vec3 center = glm::vec3(0);
+	float radius = 0;
+	glm::vec3 cone_axis = glm::vec3(0, 0, 1);
+	float cone_cutoff = 1.0f; // 1 - cone is too wide, cluster is never back-facing
+	uint32_t first_index = 0; // relative to geometry indices
+	uint32_t index_count = 0;
+};
+
+struct IndexRange{ // part of batch geometry indices, relative to batch index offset
+	uint32_t first_index = 0;
+	uint32_t index_count = 0;
+};
+
+struct InstanceRange{ // consecutive instances in instance buffer
+	uint32_t first_instance = 0;
+	uint32_t instance_count = 0;
+};
 
 struct MeshDrawInfo{
     uint32_t id = 0;
 	uint32_t vertex_offset = 0;
 	uint32_t index_offset = 0;
 	uint32_t index_count = 0;
+	int32_t material = -1; // glTF material
+	glm::mat4 cframe = glm::mat4(1.0); // world transform
 	Region region;
+	uint32_t lod_count = 1;
+	std::array<GeometryLod, MAX_LODS> lods = {};
+	uint32_t meshlet_offset = 0; // `Model::meshlets`, 0 count - geometry is drawn whole
+	uint32_t meshlet_count = 0;
+	bool double_sided = false; // material, back-facing clusters are kept
+};
+
+struct DrawBatch{ // instanced draw of meshes with same geometry and material
+	uint32_t slot = 0; // dynamic uniform buffer slot (material)
+	uint32_t vertex_offset = 0;
+	uint32_t index_offset = 0;
+	uint32_t index_count = 0;
+	uint32_t first_instance = 0; // instance buffer transforms
+	uint32_t instance_count = 0;
+	bool short_indices = false; // index_offset is in 16-bit index buffer
+	uint32_t lod_count = 1;
+	std::array<GeometryLod, MAX_LODS> lods = {};
+	uint32_t lod = 0; // selected each frame by `select_lods`
+	uint32_t meshlet_offset = 0;
+	uint32_t meshlet_count = 0;
+	bool double_sided = false;
+	std::vector<IndexRange> ranges; // visible clusters of LOD 0, merged by `cull`
+	std::vector<InstanceRange> instances; // instances inside frustum, merged by `cull`
+};
+
+struct InstanceBounds{ // instance transform data used by cluster culling
+	glm::mat4 cframe = glm::mat4(1.0);
+	glm::mat4 inverse = glm::mat4(1.0);
+	float scale = 1.0f; // largest axis scale, sphere radius to world
+	bool mirrored = false; // negative determinant, triangle winding is flipped
+	glm::vec3 camera = glm::vec3(0); // camera position in geometry space, updated every cull
+
+	InstanceBounds(){}
+	InstanceBounds(const glm::mat4& cframe) : cframe(cframe), inverse(glm::inverse(cframe))
+	{
+		scale = std::max({ glm::length(glm::vec3(cframe[0])), glm::length(glm::vec3(cframe[1])), glm::length(glm::vec3(cframe[2])) });
+		mirrored = glm::determinant(glm::mat3(cframe)) < 0;
+	}
+};
+
+struct RegionTable{ // world regions as structure of arrays, tested 4 at a time by `cull_boxes`
+	std::vector<float> min_x, min_y, min_z, max_x, max_y, max_z;
+
+	void assign(const std::vector<Region>& regions)
+	{
+		for(std::vector<float>* column : { &min_x, &min_y, &min_z, &max_x, &max_y, &max_z }) column->resize(regions.size());
+		for(size_t i = 0; i < regions.size(); i++){
+			min_x[i] = regions[i].min.x; min_y[i] = regions[i].min.y; min_z[i] = regions[i].min.z;
+			max_x[i] = regions[i].max.x; max_y[i] = regions[i].max.y; max_z[i] = regions[i].max.z;
+		}
+	}
+
+	size_t size() const { return min_x.size(); }
+	std::array<const float*, 6> columns() const { return { min_x.data(), min_y.data(), min_z.data(), max_x.data(), max_y.data(), max_z.data() }; }
+};
+
+struct TextureLayers{ // texture array layers already uploaded to GPU
+    std::set<int32_t> albedo;
+    std::set<int32_t> normal;
+    std::set<int32_t> material;
+    std::set<int32_t> emission;
 };
 
 //-------------------------------------------
+/// primitive geometry, shared by every node that references the same glTF mesh
 
-class Mesh{
+class Geometry{
 public:
-    std::string name = "mesh";
-
     std::vector<uint32_t> indices;
     std::vector<Vertex> vertices;
     Region region;
+    Region bounds; // vertex position bounds, packed positions are relative to it
+    std::vector<GeometryLod> lods; // LOD 0 first, coarser levels are appended to `indices`
+    std::vector<Meshlet> meshlets; // LOD 0 clusters, empty for small geometry
+
+    uint32_t ioffset = 0; // linear memory index offset location
+    uint32_t voffset = 0; // linear memory vertex offset location
+    uint32_t moffset = 0; // first meshlet in combined model list
+
+    // set on upload, geometry with at most 65536 vertices is drawn from 16-bit index buffer
+    bool short_indices = false;
+    uint32_t index_offset = 0; // first index in index buffer of its type
+
+    bool has_tangents = false; // TANGENT attribute was in file, tangent generation is skipped
+
+    std::shared_ptr<TriangleBvh> triangle_bvh; // LOD 0 triangles, built on first pick
+};
+
+//-------------------------------------------
 
-    struct Pixels{
-        std::vector<uint8_t> albedo;
-        std::vector<uint8_t> normal;
-        std::vector<uint8_t> material;
-        std::vector<uint8_t> emission;
+class Mesh{
+public:
+    std::string name = "mesh";
+    std::shared_ptr<Geometry> geometry;
+
+    struct Pixels{ // shared between meshes that use the same image
+        std::shared_ptr<const std::vector<uint8_t>> albedo;
+        std::shared_ptr<const std::vector<uint8_t>> normal;
+        std::shared_ptr<const std::vector<uint8_t>> material;
+        std::shared_ptr<const std::vector<uint8_t>> emission;
     } pixels;
 
+    struct Textures{ // glTF image indices, -1 means no texture
+        int32_t albedo = -1;
+        int32_t normal = -1;
+        int32_t material = -1;
+        int32_t emission = -1;
+    } textures;
+
     struct UniformMeshStruct{
         alignas(16) glm::mat4 cframe = glm::mat4(1.0);
         alignas(16) glm::vec3 base_color = glm::vec3(1.0);
@@ -36,11 +155,13 @@ public:
         alignas(4) int32_t normal_id = -1; // (occlusion, roughness, metalliness)
         alignas(4) int32_t material_id = -1;
         alignas(4) int32_t emission_id = -1;
+        alignas(16) glm::vec3 region_min = glm::vec3(0); // geometry bounds, decodes packed positions
+        alignas(16) glm::vec3 region_extent = glm::vec3(0);
     } uniform;
 
     uint32_t id = 0; // mesh id number
-    uint32_t ioffset = 0; // linear memory index offset location
-    uint32_t voffset = 0; // linear memory vertex offset location
+    int32_t material = -1; // glTF material, meshes with same geometry and material are drawn instanced
+    bool double_sided = false; // glTF material `doubleSided`
 };
 
 //-------------------------------------------
@@ -51,65 +172,7 @@ public:
     glm::mat4 cframe = glm::mat4(1.0);
     std::vector<Node> children;
     std::vector<Mesh> meshes;
-
-    void calculate_vertex_TBN(){
-        for(Mesh& mesh : meshes){
-            for(uint32_t i = 0; i < mesh.indices.size(); i=i+3)
-            {
-                // triangle indices
-                uint32_t i0 = mesh.indices[i+0]; 
-                uint32_t i1 = mesh.indices[i+1];
-                uint32_t i2 = mesh.indices[i+2];
-
-                // triangle vertices (from indices)
-                std::array<glm::vec3, 3> vertices = {
-                    mesh.vertices[i0].position,
-                    mesh.vertices[i1].position,
-                    mesh.vertices[i2].position,
-                };
-
-                std::array<glm::vec2, 3> texcoords = {
-                    mesh.vertices[i0].texcoord,
-                    mesh.vertices[i1].texcoord,
-                    mesh.vertices[i2].texcoord,
-                };
-
-                glm::vec3 pos1 = vertices[1] - vertices[0];
-                glm::vec3 pos2 = vertices[2] - vertices[0];
-
-                glm::vec2 uv1 = texcoords[1] - texcoords[0];
-                glm::vec2 uv2 = texcoords[2] - texcoords[0];
-
-                // get tangent, bitangent based on formula
-                float r = 1 / (uv1.x * uv2.y - uv1.y * uv2.x);
-                glm::vec3 tangent = (pos1 * uv2.y - pos2 * uv1.y)*r;
-                glm::vec3 bitangent = (pos2 * uv1.x - pos1 * uv2.x)*r;
-
-                // normalize
-                mesh.vertices[i0].tangent = glm::normalize(tangent);
-                mesh.vertices[i1].tangent = glm::normalize(tangent);
-                mesh.vertices[i2].tangent = glm::normalize(tangent);
-
-                mesh.vertices[i0].bitangent = glm::normalize(bitangent);
-                mesh.vertices[i1].bitangent = glm::normalize(bitangent);
-                mesh.vertices[i2].bitangent = glm::normalize(bitangent);
-            }
-        }
-        for(Node& node : children) node.calculate_vertex_TBN();
-    }
-
-    void fill_buffers(Buffer* indices, Buffer* vertices)
-    {
-        VkDeviceSize size;
-        for(Mesh& mesh : meshes){
-            size = mesh.indices.size() * sizeof(uint32_t);
-            //for(uint32_t i = 0; i < mesh.indices.size(); i++) mesh.indices[i] += mesh.ioffset; // add offset
-            indices->fill_memory(mesh.indices.data(), size, mesh.ioffset * sizeof(uint32_t));
-            size = mesh.vertices.size() * sizeof(Vertex);
-            vertices->fill_memory(mesh.vertices.data(), size, mesh.voffset * sizeof(Vertex));
-        }
-        for(Node& node : children) node.fill_buffers(indices, vertices);
-    }
+    std::vector<glm::mat4> instances; // EXT_mesh_gpu_instancing, meshes are drawn once per instance transform
 
     void get_draw_info(std::vector<MeshDrawInfo>& infos, glm::mat4 cframe_offset = glm::mat4(1.0))
     {
@@ -118,145 +181,671 @@ public:
         for(Mesh& mesh : meshes){ 
             MeshDrawInfo info;
             info.id = mesh.id;
-            info.index_offset = mesh.ioffset;
-            info.vertex_offset = mesh.voffset;
-            info.index_count = mesh.indices.size();
-            info.region = Region(
-                cframe_offset * glm::vec4(mesh.region.max.x, mesh.region.max.y, mesh.region.max.z, 1.0),
-                cframe_offset * glm::vec4(mesh.region.min.x, mesh.region.min.y, mesh.region.min.z, 1.0)
-            );
-            infos.push_back(info);
+            info.material = mesh.material;
+            info.index_offset = mesh.geometry->ioffset;
+            info.vertex_offset = mesh.geometry->voffset;
+            info.index_count = mesh.geometry->indices.size();
+            info.lod_count = std::min<uint32_t>((uint32_t)mesh.geometry->lods.size(), MAX_LODS);
+            for(uint32_t i = 0; i < info.lod_count; i++) info.lods[i] = mesh.geometry->lods[i];
+            if(info.lod_count == 0){ // single level
+                info.lod_count = 1;
+                info.lods[0] = { 0, info.index_count, 0.0f };
+            }
+            info.index_count = info.lods[0].index_count;
+            info.meshlet_offset = mesh.geometry->moffset;
+            info.meshlet_count = (uint32_t)mesh.geometry->meshlets.size();
+            info.double_sided = mesh.double_sided;
+
+            size_t instance_count = std::max<size_t>(instances.size(), 1);
+            for(size_t i = 0; i < instance_count; i++){
+                info.cframe = instances.empty()? cframe_offset : cframe_offset * instances[i];
+                info.region = transform_region(mesh.geometry->region, info.cframe);
+                infos.push_back(info);
+            }
         }
 
         for(Node& node : children) node.get_draw_info(infos, cframe_offset);
     }
 
-    void update_dynamic_buffer(Instance* instance, Descriptors *descriptors, glm::mat4 cframe_offset = glm::mat4(1.0))
+    void upload_textures(Instance* instance, Descriptors *descriptors, TextureLayers& uploaded)
     {
-        cframe_offset *= this->cframe; 
         for(Mesh& mesh : meshes)
         {   
-            // image buffers
-            if(mesh.uniform.albedo_id != -1)
+            // image buffers, each layer is uploaded once even if many meshes use it
+            if(mesh.uniform.albedo_id != -1 && uploaded.albedo.insert(mesh.uniform.albedo_id).second)
             {
                 uint32_t tex = mesh.uniform.albedo_id;
-                descriptors->albedo.fill_memory(MAX_IMAGE_SIZE, MAX_IMAGE_SIZE, 4, mesh.pixels.albedo.data(), tex);
+                descriptors->albedo.fill_memory(MAX_IMAGE_SIZE, MAX_IMAGE_SIZE, 4, mesh.pixels.albedo->data(), tex);
                 vkDestroyImageView(instance->device, descriptors->albedo_image_views[tex], nullptr);
                 descriptors->albedo_image_views[tex] = descriptors->albedo.return_image_view(tex);
             }
 
-            if(mesh.uniform.normal_id != -1)
+            if(mesh.uniform.normal_id != -1 && uploaded.normal.insert(mesh.uniform.normal_id).second)
             {
                 uint32_t tex = mesh.uniform.normal_id;
-                descriptors->normal.fill_memory(MAX_IMAGE_SIZE, MAX_IMAGE_SIZE, 4, mesh.pixels.normal.data(), tex);
+                descriptors->normal.fill_memory(MAX_IMAGE_SIZE, MAX_IMAGE_SIZE, 4, mesh.pixels.normal->data(), tex);
                 vkDestroyImageView(instance->device, descriptors->normal_image_views[tex], nullptr);
                 descriptors->normal_image_views[tex] = descriptors->normal.return_image_view(tex);
             }
             
-            if(mesh.uniform.material_id != -1)
+            if(mesh.uniform.material_id != -1 && uploaded.material.insert(mesh.uniform.material_id).second)
             {
                 uint32_t tex = mesh.uniform.material_id;
-                descriptors->material.fill_memory(MAX_IMAGE_SIZE, MAX_IMAGE_SIZE, 4, mesh.pixels.material.data(), tex);
+                descriptors->material.fill_memory(MAX_IMAGE_SIZE, MAX_IMAGE_SIZE, 4, mesh.pixels.material->data(), tex);
                 vkDestroyImageView(instance->device, descriptors->material_image_views[tex], nullptr);
                 descriptors->material_image_views[tex] = descriptors->material.return_image_view(tex);
             }
 
-            if(mesh.uniform.emission_id != -1)
+            if(mesh.uniform.emission_id != -1 && uploaded.emission.insert(mesh.uniform.emission_id).second)
             {
-                uint32_t tex = mesh.uniform.material_id;
-                descriptors->emission.fill_memory(MAX_IMAGE_SIZE, MAX_IMAGE_SIZE, 4, mesh.pixels.emission.data(), tex);
+                uint32_t tex = mesh.uniform.emission_id;
+                descriptors->emission.fill_memory(MAX_IMAGE_SIZE, MAX_IMAGE_SIZE, 4, mesh.pixels.emission->data(), tex);
                 vkDestroyImageView(instance->device, descriptors->emission_image_views[tex], nullptr);
                 descriptors->emission_image_views[tex] = descriptors->emission.return_image_view(tex);
             }
+        }
+
+        for(Node& node : children) node.upload_textures(instance, descriptors, uploaded);
+    }
 
-            // uniform buffer
-            mesh.uniform.cframe = cframe_offset;
-            descriptors->dynamic_uniform_buffer.fill_memory(&mesh.uniform, sizeof(mesh.uniform), DYNAMIC_DESCRIPTOR_SIZE * mesh.id );
+    /// node that holds mesh `id` (and the mesh), nullptr if not found
+    const Node* find_mesh(uint32_t id, const Mesh** found) const
+    {
+        for(const Mesh& mesh : meshes){
+            if(mesh.id != id) continue;
+            *found = &mesh;
+            return this;
+        }
+        for(const Node& node : children){
+            const Node* result = node.find_mesh(id, found);
+            if(result) return result;
         }
+        return nullptr;
+    }
 
-        for(Node& node : children) node.update_dynamic_buffer(instance, descriptors, cframe_offset);
+    void collect_meshes(std::map<uint32_t, const Mesh*>& collection) const
+    {
+        for(const Mesh& mesh : meshes) collection[mesh.id] = &mesh;
+        for(const Node& node : children) node.collect_meshes(collection);
     }
 };
 
+struct PickResult{
+    bool hit = false;
+    uint32_t instance = 0; // instance buffer order
+    const Node* node = nullptr; // valid while model is not changed
+    const Mesh* mesh = nullptr;
+    uint32_t triangle = 0; // LOD 0 triangle of mesh geometry
+    float distance = 0; // in ray direction units
+    glm::vec3 position = glm::vec3(0); // world hit point
+};
+
 class Model{
 private:
-    Buffer indices;
-    Buffer vertices;
+    Buffer indices; // 32-bit
+    Buffer short_indices; // 16-bit
+    Buffer positions; // vertex stream 0, tightly packed positions, depth pipeline reads only this one
+    Buffer attributes; // vertex stream 1, normal, texcoord, tangent (and bitangent for float vertices)
+
+    bool packed = false; // vertices are `PackedVertex`
+    bool gpu_driven = false; // instances are culled by compute shader and drawn with `draw_indirect`
+    uint32_t short_draw_count = 0; // instances of 16-bit index batches, first in instance buffer
+    PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count = nullptr; // from instance, missing - commands of culled draws have zero instances
 
     // 1
+    /// write geometry into staging buffer, then copy into device local index/vertex buffers
+    /// vertices are split into position and attribute streams, position only passes read less memory
     void create_buffers(Instance* instance)
     {
-        VkDeviceSize size;
+        size_t position_size = packed? sizeof(PackedVertex::position) : sizeof(glm::vec3);
+        size_t attribute_size = packed? sizeof(PackedVertex) - position_size : sizeof(VertexAttributes);
 
-        size = sizeof(uint32_t) * this->total_indices_size;
-        if(size == 0) throw std::runtime_error("model buffer is empty");
-        indices.init(instance);
-        indices.create_buffer(size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        // split index ranges by type, indices are relative to vertex offset
+        uint32_t index_count = 0, short_index_count = 0;
+        for(std::shared_ptr<Geometry>& geometry : geometries)
+        {
+            geometry->short_indices = geometry->vertices.size() <= 65536;
+            uint32_t& count = geometry->short_indices? short_index_count : index_count;
+            geometry->index_offset = count;
+            count += (uint32_t)geometry->indices.size();
+        }
+
+        VkDeviceSize index_bytes = sizeof(uint32_t) * index_count;
+        VkDeviceSize short_index_bytes = (sizeof(uint16_t) * short_index_count + 15) & ~(VkDeviceSize)15; // keeps vertices aligned in staging
+        VkDeviceSize position_bytes = (position_size * this->total_vertices_size + 15) & ~(VkDeviceSize)15;
+        VkDeviceSize attribute_bytes = attribute_size * this->total_vertices_size;
+        if(index_count + short_index_count == 0 || attribute_bytes == 0) throw std::runtime_error("model buffer is empty");
+
+        // staging layout: 32-bit indices, 16-bit indices, positions, attributes
+        VkDeviceSize position_start = index_bytes + short_index_bytes;
+        VkDeviceSize attribute_start = position_start + position_bytes;
+
+        Buffer staging;
+        staging.init(instance);
+        staging.create_buffer(attribute_start + attribute_bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        char* data = reinterpret_cast<char*>(staging.map());
+        for(std::shared_ptr<Geometry>& geometry : geometries)
+        {
+            if(geometry->short_indices){
+                uint16_t* output = reinterpret_cast<uint16_t*>(data + index_bytes) + geometry->index_offset;
+                narrow_indices(geometry->indices.data(), output, geometry->indices.size());
+            }else{
+                std::memcpy(data + geometry->index_offset * sizeof(uint32_t), geometry->indices.data(), geometry->indices.size() * sizeof(uint32_t));
+            }
+            char* position_output = data + position_start + geometry->voffset * position_size;
+            char* attribute_output = data + attribute_start + geometry->voffset * attribute_size;
+
+            if(packed){
+                geometry->bounds = get_position_bounds(geometry->vertices.data(), geometry->vertices.size());
+                for(size_t i = 0; i < geometry->vertices.size(); i++){
+                    PackedVertex vertex = PackedVertex::pack(geometry->vertices[i], geometry->bounds);
+                    std::memcpy(position_output + i * position_size, vertex.position, position_size);
+                    std::memcpy(attribute_output + i * attribute_size, vertex.normal, attribute_size); // normal to end of struct
+                }
+            }else{
+                for(size_t i = 0; i < geometry->vertices.size(); i++){
+                    const Vertex& vertex = geometry->vertices[i];
+                    VertexAttributes attribute = { vertex.normal, vertex.texcoord, vertex.tangent, vertex.bitangent };
+                    std::memcpy(position_output + i * position_size, &vertex.position, position_size);
+                    std::memcpy(attribute_output + i * attribute_size, &attribute, attribute_size);
+                }
+            }
+        }
+        staging.unmap();
+
+        if(index_count > 0){
+            indices.init(instance);
+            indices.create_buffer(index_bytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            indices.copy_from(staging, index_bytes);
+        }
+
+        if(short_index_count > 0){
+            short_indices.init(instance);
+            short_indices.create_buffer(short_index_bytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            short_indices.copy_from(staging, short_index_bytes, index_bytes);
+        }
 
-        size = sizeof(Vertex) * this->total_vertices_size;
-        if(size == 0) throw std::runtime_error("model buffer is empty");
-        vertices.init(instance);
-        vertices.create_buffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        positions.init(instance);
+        positions.create_buffer(position_bytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        positions.copy_from(staging, position_bytes, position_start);
 
-        for(Node& node : nodes) node.fill_buffers(&indices, &vertices);
-        msg::success("model buffers created");
+        attributes.init(instance);
+        attributes.create_buffer(attribute_bytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        attributes.copy_from(staging, attribute_bytes, attribute_start);
+
+        staging.destroy();
+
+        float full = (float)(sizeof(Vertex) * this->total_vertices_size) / 1024 / 1024;
+        float used = (float)(position_bytes + attribute_bytes) / 1024 / 1024;
+        msg::success("model buffers created, vertices: ", this->total_vertices_size, " (", used, " MB", packed? ", unpacked " + std::to_string(full) + " MB)" : ")");
+        msg::printl("Indices: ", index_count + short_index_count, " (", short_index_count, " 16-bit), ", (float)(index_bytes + sizeof(uint16_t) * short_index_count) / 1024 / 1024, " MB, 32-bit only ", (float)sizeof(uint32_t) * (index_count + short_index_count) / 1024 / 1024, " MB");
     }
 
 public:
     uint32_t total_indices_size = 0;
     uint32_t total_vertices_size = 0;
+    bool quantized = false; // file has integer attributes (KHR_mesh_quantization), uploaded as `PackedVertex` by default
     
     std::vector<Node> nodes;
+    std::vector<std::shared_ptr<Geometry>> geometries; // unique geometry, uploaded once
     std::vector<MeshDrawInfo> infos;
+    std::vector<DrawBatch> batches; // instanced draws, built from `infos`
+    std::vector<Region> instance_regions; // world regions in instance buffer order
+    std::vector<Meshlet> meshlets; // clusters of all geometry, in `geometries` order
+    std::vector<InstanceBounds> instance_bounds; // in instance buffer order
+    RegionTable region_table; // `instance_regions` for SIMD frustum test
+    Bvh scene_bvh; // over `instance_regions`, used for frustum test of large scenes and spatial queries
+    std::vector<uint32_t> instance_infos; // `infos` index of every instance
+    std::vector<std::shared_ptr<Geometry>> instance_geometries; // for picking
+    std::vector<uint8_t> instance_visible; // result of last frustum test
+    uint64_t draw_version = 0; // changes when any batch LOD, visible instances or clusters change, recorded commands are stale
+
+    // statistics of last `cull`
+    uint32_t culled_instances = 0;
+    uint32_t visible_meshlets = 0;
+    uint32_t culled_meshlets = 0;
+
+    //------------------------------------
+    /// pick coarsest LOD whose error projects below `LOD_PIXEL_ERROR`, using nearest instance of each batch
+    /// `pixel_scale` - pixels per world unit at distance 1 (viewport height / (2 tan(fov / 2)))
+
+    void select_lods(const glm::vec3& camera_position, float pixel_scale)
+    {
+        bool changed = false;
+        for(DrawBatch& batch : batches)
+        {
+            float size = 0; // largest projected region diameter, pixels
+            for(uint32_t i = batch.first_instance; i < batch.first_instance + batch.instance_count; i++){
+                const Region& region = instance_regions[i];
+                glm::vec3 center = (region.min + region.max) * 0.5f;
+                float diameter = glm::length(region.max - region.min);
+                float distance = glm::length(center - camera_position) - diameter * 0.5f;
+                size = distance > 0? std::max(size, diameter * pixel_scale / distance) : FLT_MAX;
+                if(size == FLT_MAX) break;
+            }
+
+            uint32_t lod = 0;
+            while(lod + 1 < batch.lod_count && batch.lods[lod + 1].error * size <= LOD_PIXEL_ERROR) lod++;
+            changed |= lod != batch.lod;
+            batch.lod = lod;
+        }
+        if(changed) draw_version++;
+    }
+
+    //------------------------------------
+    /// frustum test of every instance region, then LOD 0 clusters outside of frustum or facing away from camera
+    /// (in every visible instance) are skipped. Consecutive visible instances and clusters are merged into one draw
+
+    void cull(const glm::mat4& view_projection, const glm::vec3& camera_position)
+    {
+        Frustum frustum(view_projection);
+        instance_visible.resize(region_table.size());
+        if(instance_regions.size() >= BVH_MIN_INSTANCES) scene_bvh.cull(instance_regions, frustum, instance_visible.data());
+        else cull_boxes(region_table.columns().data(), region_table.size(), frustum, instance_visible.data());
+
+        // camera in geometry space of every instance, cone test doesn't transform clusters
+        for(InstanceBounds& instance : instance_bounds) instance.camera = glm::vec3(instance.inverse * glm::vec4(camera_position, 1.0f));
+
+        std::vector<InstanceRange> instances;
+        std::vector<IndexRange> ranges;
+        culled_instances = visible_meshlets = culled_meshlets = 0;
+
+        for(DrawBatch& batch : batches)
+        {
+            instances.clear();
+            for(uint32_t i = batch.first_instance; i < batch.first_instance + batch.instance_count; i++){
+                if(!instance_visible[i]){ culled_instances++; continue; }
+                if(!instances.empty() && instances.back().first_instance + instances.back().instance_count == i) instances.back().instance_count++;
+                else instances.push_back({ i, 1 });
+            }
+
+            bool changed = instances.size() != batch.instances.size() ||
+                !std::equal(instances.begin(), instances.end(), batch.instances.begin(), [](const InstanceRange& a, const InstanceRange& b){
+                    return a.first_instance == b.first_instance && a.instance_count == b.instance_count;
+                });
+            if(changed) batch.instances = instances;
+
+            if(batch.meshlet_count > 0 && batch.lod == 0 && !instances.empty())
+            {
+                ranges.clear();
+                for(uint32_t m = 0; m < batch.meshlet_count; m++)
+                {
+                    const Meshlet& meshlet = meshlets[batch.meshlet_offset + m];
+
+                    bool visible = false;
+                    for(uint32_t i = batch.first_instance; i < batch.first_instance + batch.instance_count && !visible; i++){
+                        if(!instance_visible[i]) continue;
+                        const InstanceBounds& instance = instance_bounds[i];
+                        glm::vec3 center = glm::vec3(instance.cframe * glm::vec4(meshlet.center, 1.0f));
+                        if(!frustum.intersects(center, meshlet.radius * instance.scale)) continue;
+
+                        // cone test in geometry space, mirrored transforms flip winding so cone is not used
+                        if(batch.double_sided || instance.mirrored){ visible = true; break; }
+                        glm::vec3 direction = meshlet.center - instance.camera;
+                        visible = glm::dot(direction, meshlet.cone_axis) < meshlet.cone_cutoff * glm::length(direction) + meshlet.radius;
+                    }
+
+                    if(!visible){ culled_meshlets++; continue; }
+                    visible_meshlets++;
+                    if(!ranges.empty() && ranges.back().first_index + ranges.back().index_count == meshlet.first_index) ranges.back().index_count += meshlet.index_count;
+                    else ranges.push_back({ meshlet.first_index, meshlet.index_count });
+                }
+
+                bool ranges_changed = ranges.size() != batch.ranges.size() ||
+                    !std::equal(ranges.begin(), ranges.end(), batch.ranges.begin(), [](const IndexRange& a, const IndexRange& b){
+                        return a.first_index == b.first_index && a.index_count == b.index_count;
+                    });
+                if(ranges_changed) batch.ranges = ranges;
+                changed |= ranges_changed;
+            }
+
+            if(changed) draw_version++;
+        }
+    }
+
+    //------------------------------------
+    /// group `infos` by geometry and material, write batch uniforms and instance transforms
+
+    void create_batches(Descriptors* descriptors)
+    {
+        batches.clear();
+        if(infos.empty()) return;
+        if(infos.size() > MAX_INSTANCES) throw std::runtime_error("too many mesh instances: " + std::to_string(infos.size()));
+
+        std::map<uint32_t, const Mesh*> meshes;
+        for(const Node& node : nodes) node.collect_meshes(meshes);
+
+        // 16-bit batches first, so index buffer is rebound once
+        std::vector<uint8_t> long_indices(infos.size());
+        for(size_t i = 0; i < infos.size(); i++) long_indices[i] = !meshes.at(infos[i].id)->geometry->short_indices;
+
+        auto key = [&](uint32_t i){ return std::make_tuple(long_indices[i], infos[i].index_offset, infos[i].vertex_offset, infos[i].index_count, infos[i].material); };
+
+        std::vector<uint32_t> order(infos.size());
+        for(uint32_t i = 0; i < order.size(); i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b){ return key(a) < key(b); });
+
+        std::vector<glm::mat4> transforms(infos.size());
+        instance_regions.resize(infos.size());
+        instance_bounds.resize(infos.size());
+        instance_infos = order;
+        instance_geometries.resize(infos.size());
+        for(uint32_t i = 0; i < order.size(); i++)
+        {
+            const MeshDrawInfo& info = infos[order[i]];
+            transforms[i] = info.cframe;
+            instance_regions[i] = info.region;
+            instance_bounds[i] = InstanceBounds(info.cframe);
+            instance_geometries[i] = meshes.at(info.id)->geometry;
+
+            if(i > 0 && key(order[i - 1]) == key(order[i])){
+                batches.back().instance_count++;
+                continue;
+            }
+
+            const Mesh* mesh = meshes.at(info.id);
+
+            DrawBatch batch;
+            batch.slot = (uint32_t)batches.size();
+            batch.vertex_offset = info.vertex_offset;
+            batch.index_offset = mesh->geometry->index_offset;
+            batch.index_count = info.index_count;
+            batch.first_instance = i;
+            batch.instance_count = 1;
+            batch.short_indices = mesh->geometry->short_indices;
+            batch.lod_count = info.lod_count;
+            batch.lods = info.lods;
+            batch.meshlet_offset = info.meshlet_offset;
+            batch.meshlet_count = info.meshlet_count;
+            batch.double_sided = info.double_sided;
+            for(uint32_t m = 0; m < batch.meshlet_count; m++) batch.ranges.push_back({ meshlets[batch.meshlet_offset + m].first_index, meshlets[batch.meshlet_offset + m].index_count });
+            if(batch.slot >= MAX_OBJECTS) throw std::runtime_error("too many draw batches (different meshes/materials)");
+
+            // material of first instance, cframe comes from instance buffer
+            Mesh::UniformMeshStruct uniform = mesh->uniform;
+            uniform.cframe = info.cframe;
+            uniform.region_min = packed? mesh->geometry->bounds.min : glm::vec3(0); // identity for float positions
+            uniform.region_extent = packed? mesh->geometry->bounds.max - mesh->geometry->bounds.min : glm::vec3(1);
+            descriptors->dynamic_uniform_buffer.fill_memory(&uniform, sizeof(uniform), DYNAMIC_DESCRIPTOR_SIZE * batch.slot);
+            if(gpu_driven) descriptors->material_buffer.fill_memory(&uniform, sizeof(uniform), sizeof(uniform) * batch.slot); // std430 array
+            batches.push_back(batch);
+        }
+
+        for(DrawBatch& batch : batches) batch.instances.assign(1, { batch.first_instance, batch.instance_count }); // all visible until first `cull`
+        region_table.assign(instance_regions);
+
+        uint64_t bvh_time = timestamp_micro();
+        scene_bvh.build(instance_regions);
+        msg::printl("Scene BVH: ", scene_bvh.nodes.size(), " nodes, ", (float)(timestamp_micro() - bvh_time) / 1000, " ms");
+
+        descriptors->instance_buffer.fill_memory(transforms.data(), sizeof(glm::mat4) * transforms.size());
+        if(gpu_driven) write_draws(descriptors);
+        msg::printl("Draw calls: ", gpu_driven? 2 : batches.size(), gpu_driven? " indirect" : "", " (", infos.size(), " meshes)");
+    }
+
+    //------------------------------------
+    /// draw record of every instance for cull shader: world region, LOD index ranges and material slot
+
+    void write_draws(Descriptors* descriptors)
+    {
+        std::vector<IndirectDrawStruct> draws(instance_regions.size());
+        short_draw_count = 0;
+        for(const DrawBatch& batch : batches){
+            if(batch.short_indices) short_draw_count += batch.instance_count;
+
+            for(uint32_t i = batch.first_instance; i < batch.first_instance + batch.instance_count; i++){
+                IndirectDrawStruct& draw = draws[i];
+                draw.region_min = instance_regions[i].min;
+                draw.region_max = instance_regions[i].max;
+                draw.slot = batch.slot;
+                draw.lod_count = batch.lod_count;
+                draw.vertex_offset = (int32_t)batch.vertex_offset;
+                draw.index_offset = batch.index_offset;
+                for(uint32_t l = 0; l < batch.lod_count; l++){
+                    draw.first_index[l] = batch.lods[l].first_index;
+                    draw.index_count[l] = batch.lods[l].index_count;
+                    draw.error[l] = batch.lods[l].error;
+                }
+            }
+        }
+        descriptors->draw_buffer.fill_memory(draws.data(), sizeof(IndirectDrawStruct) * draws.size());
+    }
+
+    //------------------------------------
+    /// closest triangle hit by world `ray`: scene BVH over instances, then triangle BVH of instance geometry
+    /// (built on first hit of that geometry, so the first pick of large mesh is slower)
+
+    PickResult pick(const Ray& ray)
+    {
+        PickResult result;
+        float closest = FLT_MAX;
+
+        scene_bvh.traverse(ray, closest, [&](uint32_t instance, float& instance_max){
+            if(Bvh::intersect(ray, instance_regions[instance], instance_max) == FLT_MAX) return;
+
+            Geometry& geometry = *instance_geometries[instance];
+            if(!geometry.triangle_bvh){
+                uint64_t start = timestamp_micro();
+                uint32_t index_count = geometry.lods.empty()? (uint32_t)geometry.indices.size() : geometry.lods[0].index_count;
+                geometry.triangle_bvh = std::make_shared<TriangleBvh>();
+                geometry.triangle_bvh->build(geometry.indices, geometry.vertices, 0, index_count);
+                msg::printl("Triangle BVH: ", index_count / 3, " triangles, ", (float)(timestamp_micro() - start) / 1000, " ms");
+            }
+
+            const TriangleBvh& triangles = *geometry.triangle_bvh;
+            Ray local = ray.transformed(instance_bounds[instance].inverse); // same distances as world ray
+            triangles.bvh.traverse(local, instance_max, [&](uint32_t triangle, float& triangle_max){
+                const uint32_t* index = &geometry.indices[triangles.first_index + triangle * 3];
+                float distance = Bvh::intersect(local, geometry.vertices[index[0]].position, geometry.vertices[index[1]].position, geometry.vertices[index[2]].position);
+                if(distance >= triangle_max) return;
+
+                triangle_max = distance;
+                result.hit = true;
+                result.instance = instance;
+                result.triangle = triangle;
+            });
+        });
+
+        if(!result.hit) return result;
+        result.distance = closest;
+        result.position = ray.origin + ray.direction * closest;
+        for(const Node& node : nodes){
+            result.node = node.find_mesh(infos[instance_infos[result.instance]].id, &result.mesh);
+            if(result.node) break;
+        }
+        return result;
+    }
+
+    //------------------------------------
+    /// node `cframe` changed: recompute draw transforms and world regions, refit scene BVH (batches are kept).
+    /// Instance buffer is rewritten, so frames in flight must be finished
+
+    void update_transforms(Descriptors* descriptors)
+    {
+        std::vector<MeshDrawInfo> updated;
+        updated.reserve(infos.size());
+        for(Node& node : nodes) node.get_draw_info(updated);
+        if(updated.size() != infos.size()) throw std::runtime_error("node hierarchy changed, batches must be rebuilt");
+        infos.swap(updated);
+
+        std::vector<glm::mat4> transforms(infos.size());
+        for(uint32_t i = 0; i < instance_infos.size(); i++){
+            const MeshDrawInfo& info = infos[instance_infos[i]];
+            transforms[i] = info.cframe;
+            instance_regions[i] = info.region;
+            instance_bounds[i] = InstanceBounds(info.cframe);
+        }
+        region_table.assign(instance_regions);
+        scene_bvh.refit(instance_regions);
+
+        descriptors->instance_buffer.fill_memory(transforms.data(), sizeof(glm::mat4) * transforms.size());
+        if(gpu_driven) write_draws(descriptors);
+        draw_version++;
+    }
 
     // 2
-    void prepare_model(Instance* instance, Descriptors* descriptors)
+    /// upload model, tangents and `infos` are already computed by loader (or read from cache)
+    /// `packed` - vertices are uploaded as `PackedVertex` (pipeline must use packed shader)
+    /// `gpu_driven` - write draw records and materials for `record_culling` and `draw_indirect`
+    void prepare_model(Instance* instance, Descriptors* descriptors, bool packed = false, bool gpu_driven = false)
     {
-        for(Node& node : nodes) node.calculate_vertex_TBN();
+        this->packed = packed;
+        this->gpu_driven = gpu_driven;
+        this->draw_indexed_indirect_count = instance->draw_indexed_indirect_count;
         create_buffers(instance);
-        for(Node& node : nodes) node.update_dynamic_buffer(instance, descriptors);
-        for(Node& node : nodes) node.get_draw_info(infos);
+
+        meshlets.clear();
+        for(std::shared_ptr<Geometry>& geometry : geometries) meshlets.insert(meshlets.end(), geometry->meshlets.begin(), geometry->meshlets.end());
+
+        TextureLayers uploaded;
+        for(Node& node : nodes) node.upload_textures(instance, descriptors, uploaded);
+        create_batches(descriptors);
     }
 
     // 3
-    void draw(VkCommandBuffer* cmd, VkPipelineLayout *pipeline_layout, Descriptors *descriptors)
+    /// `position_only` - bind only position stream (depth pipeline)
+    void draw(VkCommandBuffer* cmd, VkPipelineLayout *pipeline_layout, Descriptors *descriptors, bool position_only = false)
     {
-        for(MeshDrawInfo& info : infos){
-            std::array<uint32_t, 1> dbo = { DYNAMIC_DESCRIPTOR_SIZE * info.id }; // dynamic buffer offset;
-            VkDeviceSize vertex_offset = 0;
-
-            vkCmdBindVertexBuffers(*cmd, 0, 1, &vertices.buffer, &vertex_offset);
-            vkCmdBindIndexBuffer(*cmd, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+        VkBuffer streams[] = { positions.buffer, attributes.buffer };
+        VkDeviceSize stream_offsets[] = { 0, 0 };
+        vkCmdBindVertexBuffers(*cmd, 0, position_only? 1 : 2, streams, stream_offsets);
+
+        std::optional<bool> bound_short; // index type of bound index buffer
+        for(DrawBatch& batch : batches){
+            if(batch.instances.empty()) continue; // every instance is outside of frustum
+            if(bound_short != batch.short_indices){
+                if(batch.short_indices) vkCmdBindIndexBuffer(*cmd, short_indices.buffer, 0, VK_INDEX_TYPE_UINT16);
+                else vkCmdBindIndexBuffer(*cmd, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+                bound_short = batch.short_indices;
+            }
+            std::array<uint32_t, 1> dbo = { DYNAMIC_DESCRIPTOR_SIZE * batch.slot }; // dynamic buffer offset;
 
             vkCmdBindDescriptorSets(*cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, *pipeline_layout, 0, 1, &descriptors->descriptor_sets, 1, dbo.data());
-            vkCmdDrawIndexed(*cmd, info.index_count, 1, info.index_offset, info.vertex_offset, 0);
+
+            // visible clusters of LOD 0, or whole selected LOD
+            const GeometryLod& lod = batch.lods[batch.lod];
+            const IndexRange whole = { lod.first_index, lod.index_count };
+            bool clusters = batch.meshlet_count > 0 && batch.lod == 0;
+            const IndexRange* ranges = clusters? batch.ranges.data() : &whole;
+            size_t range_count = clusters? batch.ranges.size() : 1;
+
+            for(const InstanceRange& instances : batch.instances){
+                for(size_t r = 0; r < range_count; r++){
+                    vkCmdDrawIndexed(*cmd, ranges[r].index_count, instances.instance_count, batch.index_offset + ranges[r].first_index, batch.vertex_offset, instances.first_instance);
+                }
+            }
+        }
+    }
+
+    //------------------------------------
+    // GPU driven rendering: compute shader replaces `select_lods` and `cull`, commands are recorded once
+
+    /// frustum and LOD parameters of next cull dispatch, statistics are read from count slot of `image`,
+    /// its command buffer finished when swapchain waited the image fence
+    void update_culling(Descriptors* descriptors, const glm::mat4& view_projection, const glm::vec3& camera_position, float pixel_scale, uint32_t image)
+    {
+        UniformCullingStruct culling;
+        Frustum frustum(view_projection);
+        std::copy(std::begin(frustum.planes), std::end(frustum.planes), std::begin(culling.planes));
+        culling.camera = camera_position;
+        culling.pixel_scale = pixel_scale;
+        culling.draw_count = (uint32_t)instance_regions.size();
+        culling.short_draw_count = short_draw_count;
+        culling.compact = draw_indexed_indirect_count != nullptr;
+        culling.lod_error = LOD_PIXEL_ERROR;
+        descriptors->culling_buffer.fill_memory(&culling, sizeof(culling));
+
+        if(image >= MAX_SWAPCHAIN_IMAGES) return;
+        const uint32_t* counts = descriptors->counts + 2 * (1 + image);
+        culled_instances = culling.draw_count - std::min(culling.draw_count, counts[0] + counts[1]);
+    }
+
+    /// clear counts and dispatch cull shader, outside of render pass, then copy counts to slot of swapchain `image`.
+    /// Barriers order it after indirect reads and copies of earlier frames and before draws of this frame
+    void record_culling(VkCommandBuffer* cmd, VkPipelineLayout *pipeline_layout, Descriptors *descriptors, uint32_t image)
+    {
+        if(instance_regions.empty()) return;
+
+        const VkDeviceSize counts_size = sizeof(uint32_t) * 2;
+        VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        vkCmdPipelineBarrier(*cmd, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+        vkCmdFillBuffer(*cmd, descriptors->count_buffer.buffer, 0, counts_size, 0);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(*cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        std::array<uint32_t, 1> dbo = { 0 }; // dynamic buffer offset, not used by cull shader
+        vkCmdBindDescriptorSets(*cmd, VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline_layout, 0, 1, &descriptors->descriptor_sets, 1, dbo.data());
+        vkCmdDispatch(*cmd, ((uint32_t)instance_regions.size() + 63) / 64, 1, 1); // local_size_x = 64
+
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(*cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        // statistics copy, host reads it after fence of this command buffer
+        if(image >= MAX_SWAPCHAIN_IMAGES) return;
+        VkBufferCopy region = { 0, counts_size * (1 + image), counts_size };
+        vkCmdCopyBuffer(*cmd, descriptors->count_buffer.buffer, descriptors->count_buffer.buffer, 1, &region);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(*cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    /// one indirect draw per index buffer, materials are indexed by draw so descriptor set is bound once
+    void draw_indirect(VkCommandBuffer* cmd, VkPipelineLayout *pipeline_layout, Descriptors *descriptors, bool position_only = false)
+    {
+        if(instance_regions.empty()) return;
+
+        VkBuffer streams[] = { positions.buffer, attributes.buffer };
+        VkDeviceSize stream_offsets[] = { 0, 0 };
+        vkCmdBindVertexBuffers(*cmd, 0, position_only? 1 : 2, streams, stream_offsets);
+
+        std::array<uint32_t, 1> dbo = { 0 }; // dynamic buffer offset, material comes from material buffer
+        vkCmdBindDescriptorSets(*cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, *pipeline_layout, 0, 1, &descriptors->descriptor_sets, 1, dbo.data());
+
+        uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        std::array<uint32_t, 2> first = { 0, short_draw_count };
+        std::array<uint32_t, 2> count = { short_draw_count, (uint32_t)instance_regions.size() - short_draw_count };
+        for(uint32_t type = 0; type < 2; type++){ // 16-bit, 32-bit
+            if(count[type] == 0) continue;
+            if(type == 0) vkCmdBindIndexBuffer(*cmd, short_indices.buffer, 0, VK_INDEX_TYPE_UINT16);
+            else vkCmdBindIndexBuffer(*cmd, indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+            VkDeviceSize offset = (VkDeviceSize)first[type] * stride;
+            if(draw_indexed_indirect_count) draw_indexed_indirect_count(*cmd, descriptors->indirect_buffer.buffer, offset, descriptors->count_buffer.buffer, sizeof(uint32_t) * type, count[type], stride);
+            else vkCmdDrawIndexedIndirect(*cmd, descriptors->indirect_buffer.buffer, offset, count[type], stride);
         }
     }
 
     // 4
     void destroy(){
-        vertices.destroy();
+        positions.destroy();
+        attributes.destroy();
+        short_indices.destroy();
         indices.destroy();
     }
 
     //------------------------------------
-    /// combined mesh region
+    /// vertices are `PackedVertex`, model and depth pipelines must be created for it
+
+    bool is_packed()
+    {
+        return this->packed;
+    }
+
+    /// combined mesh region, reduced over `region_table` columns
 
     Region get_region()
     {
-        Region r = infos[0].region;
-        for(MeshDrawInfo& info : infos)
-        {
-            //msg::success(info.region.max, info.region.min);
-            r.max.x = r.max.x > info.region.max.x? r.max.x : info.region.max.x;
-            r.max.y = r.max.y > info.region.max.y? r.max.y : info.region.max.y;
-            r.max.z = r.max.z > info.region.max.z? r.max.z : info.region.max.z;
-
-            r.min.x = r.min.x < info.region.min.x? r.min.x : info.region.min.x;
-            r.min.y = r.min.y < info.region.min.y? r.min.y : info.region.min.y;
-            r.min.z = r.min.z < info.region.min.z? r.min.z : info.region.min.z;
-        }
-        return r;
+        size_t count = region_table.size();
+        if(count == 0) return Region();
+        return Region(
+            glm::vec3(reduce_min(region_table.min_x.data(), count), reduce_min(region_table.min_y.data(), count), reduce_min(region_table.min_z.data(), count)),
+            glm::vec3(reduce_max(region_table.max_x.data(), count), reduce_max(region_table.max_y.data(), count), reduce_max(region_table.max_z.data(), count))
+        );
     }
 };
 
@@ -0,0 +1,240 @@
+#pragma once
+#include "common.hpp"
+
+//-------------------------------------------------------------------
+// Index/vertex order optimization for `Geometry`, runs after extraction (result is cached).
+// Triangles are reordered for post-transform vertex cache (Tipsify, Sander et al. 2007),
+// Tipsify clusters are sorted outside-in to reduce overdraw, then vertices follow first use.
+
+const uint32_t VERTEX_CACHE_SIZE = 16; // FIFO entries assumed by reorder and statistics
+
+struct VertexCacheStats{
+    float acmr = 0; // average cache miss ratio, transformed vertices per triangle (0.5 - 3)
+    float atvr = 0; // average transformed to vertex ratio (1 - best)
+};
+
+//-------------------------------------------------------------------
+/// FIFO post-transform cache simulation
+
+VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size = VERTEX_CACHE_SIZE)
+{
+    VertexCacheStats stats;
+    if(indices.empty()) return stats;
+
+    std::vector<uint32_t> timestamps(vertex_count, 0); // miss counter value when vertex entered cache
+    std::vector<uint8_t> used(vertex_count, 0);
+    uint32_t misses = 0, unique = 0;
+
+    for(uint32_t index : indices){
+        if(misses - timestamps[index] >= cache_size || !used[index]){ // evicted or never loaded
+            if(!used[index]){ used[index] = 1; unique++; }
+            misses++;
+            timestamps[index] = misses;
+        }
+    }
+
+    stats.acmr = (float)misses / (indices.size() / 3);
+    stats.atvr = (float)misses / unique;
+    return stats;
+}
+
+//-------------------------------------------------------------------
+/// Tipsify triangle order, `clusters` receives first triangle of every part that starts after a dead end
+
+std::vector<uint32_t> tipsify(const std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size, std::vector<uint32_t>& clusters)
+{
+    size_t triangle_count = indices.size() / 3;
+
+    // vertex -> triangle adjacency (CSR)
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for(uint32_t index : indices) offsets[index + 1]++;
+    for(size_t v = 0; v < vertex_count; v++) offsets[v + 1] += offsets[v];
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < indices.size(); i++) adjacency[cursor[indices[i]]++] = (uint32_t)(i / 3);
+
+    std::vector<uint32_t> live(vertex_count); // triangles not yet emitted per vertex
+    for(size_t v = 0; v < vertex_count; v++) live[v] = offsets[v + 1] - offsets[v];
+
+    std::vector<uint32_t> cache_time(vertex_count, 0);
+    std::vector<uint8_t> emitted(triangle_count, 0);
+    std::vector<uint32_t> dead_end; // recently used vertices, fallback when 1-ring is exhausted
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    uint32_t time = cache_size + 1;
+    uint32_t scan = 0; // next vertex for linear dead end search
+
+    auto skip_dead_end = [&]() -> int64_t {
+        while(!dead_end.empty()){
+            uint32_t vertex = dead_end.back();
+            dead_end.pop_back();
+            if(live[vertex] > 0) return vertex;
+        }
+        for(; scan < vertex_count; scan++) if(live[scan] > 0) return scan;
+        return -1;
+    };
+
+    int64_t fan = skip_dead_end();
+    if(fan >= 0) clusters.push_back(0);
+
+    while(fan >= 0)
+    {
+        candidates.clear();
+
+        // emit every remaining triangle around fanning vertex
+        for(uint32_t i = offsets[fan]; i < offsets[fan + 1]; i++){
+            uint32_t triangle = adjacency[i];
+            if(emitted[triangle]) continue;
+
+            for(uint32_t k = 0; k < 3; k++){
+                uint32_t vertex = indices[triangle * 3 + k];
+                output.push_back(vertex);
+                dead_end.push_back(vertex);
+                candidates.push_back(vertex);
+                live[vertex]--;
+                if(time - cache_time[vertex] > cache_size) cache_time[vertex] = time++;
+            }
+            emitted[triangle] = 1;
+        }
+
+        // next fanning vertex: oldest candidate that stays in cache while its fan is emitted
+        int64_t best = -1;
+        int64_t best_priority = -1;
+        for(uint32_t vertex : candidates){
+            if(live[vertex] == 0) continue;
+            int64_t priority = 0;
+            if(time - cache_time[vertex] + 2 * live[vertex] <= cache_size) priority = time - cache_time[vertex];
+            if(priority > best_priority){
+                best_priority = priority;
+                best = vertex;
+            }
+        }
+
+        if(best == -1){
+            best = skip_dead_end();
+            if(best >= 0) clusters.push_back((uint32_t)(output.size() / 3));
+        }
+        fan = best;
+    }
+
+    return output;
+}
+
+//-------------------------------------------------------------------
+/// stable sort of triangle clusters, outward facing clusters far from mesh center are drawn first
+
+void sort_clusters_for_overdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters)
+{
+    size_t triangle_count = indices.size() / 3;
+    if(clusters.size() < 2) return;
+
+    struct Cluster{
+        uint32_t begin = 0, end = 0; // triangles
+        glm::vec3 center = glm::vec3(0); // area weighted
+        glm::vec3 normal = glm::vec3(0);
+        float sort = 0;
+    };
+    std::vector<Cluster> parts(clusters.size());
+    glm::vec3 mesh_center(0);
+    float mesh_area = 0;
+
+    for(size_t c = 0; c < clusters.size(); c++)
+    {
+        Cluster& part = parts[c];
+        part.begin = clusters[c];
+        part.end = c + 1 < clusters.size()? clusters[c + 1] : (uint32_t)triangle_count;
+
+        float area = 0;
+        for(uint32_t t = part.begin; t < part.end; t++){
+            const glm::vec3& p0 = vertices[indices[t*3 + 0]].position;
+            const glm::vec3& p1 = vertices[indices[t*3 + 1]].position;
+            const glm::vec3& p2 = vertices[indices[t*3 + 2]].position;
+
+            glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+            float triangle_area = glm::length(cross);
+            part.center += (p0 + p1 + p2) * (triangle_area / 3.0f);
+            part.normal += cross;
+            area += triangle_area;
+        }
+
+        mesh_center += part.center;
+        mesh_area += area;
+        part.center = area > 0? part.center / area : vertices[indices[part.begin * 3]].position;
+    }
+    if(mesh_area > 0) mesh_center /= mesh_area;
+
+    for(Cluster& part : parts){
+        float length = glm::length(part.normal);
+        part.sort = length > 0? glm::dot(part.center - mesh_center, part.normal / length) : 0.0f;
+    }
+    std::stable_sort(parts.begin(), parts.end(), [](const Cluster& a, const Cluster& b){ return a.sort > b.sort; });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(indices.size());
+    for(const Cluster& part : parts) sorted.insert(sorted.end(), indices.begin() + part.begin * 3, indices.begin() + part.end * 3);
+    indices.swap(sorted);
+}
+
+//-------------------------------------------------------------------
+/// renumber vertices in order of first use, unreferenced vertices are moved to the end
+
+void optimize_vertex_fetch(Geometry& geometry)
+{
+    const uint32_t unused = UINT32_MAX;
+    std::vector<uint32_t> remap(geometry.vertices.size(), unused);
+    uint32_t next = 0;
+
+    for(uint32_t& index : geometry.indices){
+        if(remap[index] == unused) remap[index] = next++;
+        index = remap[index];
+    }
+    for(uint32_t& target : remap) if(target == unused) target = next++;
+
+    std::vector<Vertex> vertices(geometry.vertices.size());
+    for(size_t v = 0; v < remap.size(); v++) vertices[remap[v]] = geometry.vertices[v];
+    geometry.vertices.swap(vertices);
+}
+
+//-------------------------------------------------------------------
+/// cache, overdraw and fetch order of single geometry, returns cache statistics before and after
+
+std::pair<VertexCacheStats, VertexCacheStats> optimize_geometry(Geometry& geometry, bool overdraw = true)
+{
+    size_t vertex_count = geometry.vertices.size();
+    for(uint32_t index : geometry.indices) if(index >= vertex_count) throw std::runtime_error("index is out of vertex range");
+
+    VertexCacheStats before = analyze_vertex_cache(geometry.indices, vertex_count);
+    if(geometry.indices.size() < 3 || geometry.indices.size() % 3 != 0) return { before, before };
+
+    std::vector<uint32_t> clusters;
+    geometry.indices = tipsify(geometry.indices, vertex_count, VERTEX_CACHE_SIZE, clusters);
+    if(overdraw) sort_clusters_for_overdraw(geometry.indices, geometry.vertices, clusters);
+    optimize_vertex_fetch(geometry);
+
+    return { before, analyze_vertex_cache(geometry.indices, vertex_count) };
+}
+
+/// optimize every geometry on worker threads, statistics of meshes with at least `report_triangles` are printed
+void optimize_geometries(std::vector<std::shared_ptr<Geometry>>& geometries, size_t report_triangles = 1024)
+{
+    std::vector<std::pair<VertexCacheStats, VertexCacheStats>> stats(geometries.size());
+    parallel_for((uint32_t)geometries.size(), [&](uint32_t i){ stats[i] = optimize_geometry(*geometries[i]); });
+
+    double triangles = 0, misses_before = 0, misses_after = 0;
+    for(size_t i = 0; i < geometries.size(); i++)
+    {
+        size_t triangle_count = geometries[i]->indices.size() / 3;
+        triangles += triangle_count;
+        misses_before += stats[i].first.acmr * triangle_count;
+        misses_after += stats[i].second.acmr * triangle_count;
+
+        if(triangle_count < report_triangles) continue;
+        msg::printl("  primitive ", i, " (", triangle_count, " triangles) ACMR: ", stats[i].first.acmr, " -> ", stats[i].second.acmr,
+            ", ATVR: ", stats[i].first.atvr, " -> ", stats[i].second.atvr);
+    }
+
+    if(triangles > 0) msg::printl("Vertex cache ACMR: ", misses_before / triangles, " -> ", misses_after / triangles, " (", (size_t)triangles, " triangles)");
+}
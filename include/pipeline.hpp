@@ -100,7 +100,7 @@ class Pipeline{
 public:
     
     VkPipelineLayout pipeline_layout;
-    VkPipeline graphics_pipeline;
+    VkPipeline graphics_pipeline = VK_NULL_HANDLE; // also compute pipeline of `create_cull_pipeline`
 
     void init(Instance *instance, Descriptors *descriptors, VkRenderPass *render_pass)
     {
@@ -115,7 +115,8 @@ public:
         vkDestroyPipelineLayout(instance->device, pipeline_layout, nullptr);
     }
 
-    void create_graphics_pipeline()
+    /// `packed` - model vertices are `PackedVertex` (`Model::is_packed`)
+    void create_graphics_pipeline(bool packed = PACKED_VERTICES)
     {
         // dynamic things in pipeline: size of the viewport, line width and blend constants
         // stages - https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/VkPipelineStageFlagBits.html
@@ -131,7 +132,7 @@ public:
         //std::vector<char> vertShaderCode = read_file("shaders/vert-model.spv");
         //std::vector<char> fragShaderCode = read_file("shaders/frag-model.spv");
 
-        std::vector<char> vertShaderCode = read_file("shaders/vert-model.spv");
+        std::vector<char> vertShaderCode = read_file(packed? "shaders/vert-model-packed.spv" : "shaders/vert-model.spv");
         std::vector<char> fragShaderCode = read_file("shaders/frag-model.spv");
 
         // wrap code in shader module to pass it into pipeline
@@ -150,17 +151,32 @@ public:
         fragShaderStageInfo.module = fragShaderModule;
         fragShaderStageInfo.pName = "main";
 
+        // GPU_DRIVEN shaders read material by draw instead of dynamic uniform
+        VkSpecializationMapEntry specialization_entry = { 0, 0, sizeof(VkBool32) };
+        VkBool32 gpu_driven = GPU_DRIVEN;
+        VkSpecializationInfo specialization = { 1, &specialization_entry, sizeof(VkBool32), &gpu_driven };
+        vertShaderStageInfo.pSpecializationInfo = &specialization;
+        fragShaderStageInfo.pSpecializationInfo = &specialization;
+
         VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
         // define if data is per-vertex or per-instance, what data to load
-        VkVertexInputBindingDescription bindingDescription = Vertex::get_binding_description();
-        std::array attributeDescriptions = Vertex::get_attribute_descriptions();
+        // two streams: positions (binding 0) and remaining attributes (binding 1)
+        std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = packed? PackedVertex::get_binding_descriptions() : Vertex::get_binding_descriptions();
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+        if(packed){
+            auto compact = PackedVertex::get_attribute_descriptions();
+            attributeDescriptions.assign(compact.begin(), compact.end());
+        }else{
+            auto full = Vertex::get_attribute_descriptions();
+            attributeDescriptions.assign(full.begin(), full.end());
+        }
 
         // vertex input description
         VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputInfo.vertexBindingDescriptionCount = 1;
-        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription; 
+        vertexInputInfo.vertexBindingDescriptionCount = (uint32_t)bindingDescriptions.size();
+        vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data(); 
         vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)attributeDescriptions.size();
         vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data(); 
 
@@ -218,7 +234,7 @@ public:
         depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
         depthStencil.depthTestEnable = VK_TRUE; // compare depth of new frags with depth buffer if they should be discarded
         depthStencil.depthWriteEnable = VK_TRUE; // if they pass depth test, write to depth buffer
-        depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+        depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL; // equal - depth already written by depth prepass
         depthStencil.depthBoundsTestEnable = VK_FALSE;
         depthStencil.minDepthBounds = 0.0f; // Optional
         depthStencil.maxDepthBounds = 1.0f; // Optional
@@ -303,14 +319,14 @@ public:
         VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
         // define if data is per-vertex or per-instance, what data to load
-        VkVertexInputBindingDescription bindingDescription = Vertex::get_binding_description();
+        std::array bindingDescriptions = Vertex::get_binding_descriptions();
         std::array attributeDescriptions = Vertex::get_attribute_descriptions();
 
         // vertex input description
         VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputInfo.vertexBindingDescriptionCount = 1;
-        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription; 
+        vertexInputInfo.vertexBindingDescriptionCount = (uint32_t)bindingDescriptions.size();
+        vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data(); 
         vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)attributeDescriptions.size();
         vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data(); 
 
@@ -428,6 +444,165 @@ public:
     }
 
 
+    /// depth only pipeline, reads position stream (`Model::draw(..., true)`), no fragment shader
+    void create_depth_pipeline(bool packed = PACKED_VERTICES)
+    {
+        std::vector<char> vertShaderCode = read_file("shaders/vert-depth.spv");
+        VkShaderModule vertShaderModule = create_shader_module(vertShaderCode);
+
+        VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
+        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+        vertShaderStageInfo.module = vertShaderModule;
+        vertShaderStageInfo.pName = "main";
+
+        VkSpecializationMapEntry specialization_entry = { 0, 0, sizeof(VkBool32) }; // same as model pipeline
+        VkBool32 gpu_driven = GPU_DRIVEN;
+        VkSpecializationInfo specialization = { 1, &specialization_entry, sizeof(VkBool32), &gpu_driven };
+        vertShaderStageInfo.pSpecializationInfo = &specialization;
+
+        // position stream only (binding 0): float vec3 (12 bytes) or unorm16 packed position (8 bytes)
+        VkVertexInputBindingDescription bindingDescription = packed? PackedVertex::get_binding_descriptions()[0] : Vertex::get_binding_descriptions()[0];
+        VkVertexInputAttributeDescription attributeDescription = packed? PackedVertex::get_attribute_descriptions()[0] : Vertex::get_attribute_descriptions()[0];
+
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription; 
+        vertexInputInfo.vertexAttributeDescriptionCount = 1;
+        vertexInputInfo.pVertexAttributeDescriptions = &attributeDescription; 
+
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+        VkViewport viewport = {}; // flip height (y) axis, same as model pipeline
+        viewport.x = 0.0f;
+        viewport.y = (float)this->instance->surface.capabilities.currentExtent.height; 
+        viewport.width = (float)this->instance->surface.capabilities.currentExtent.width;
+        viewport.height = -(float)this->instance->surface.capabilities.currentExtent.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+
+        VkRect2D scissor = {}; 
+        scissor.offset = {0, 0};
+        scissor.extent = this->instance->surface.capabilities.currentExtent;
+
+        VkPipelineViewportStateCreateInfo viewportState = {};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = 1;
+        viewportState.pViewports = &viewport;
+        viewportState.scissorCount = 1;
+        viewportState.pScissors = &scissor;
+
+        VkPipelineRasterizationStateCreateInfo rasterizer = {};
+        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.depthClampEnable = VK_FALSE;
+        rasterizer.rasterizerDiscardEnable = VK_FALSE;
+        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizer.lineWidth = 1.0f;
+        rasterizer.cullMode = VK_CULL_MODE_NONE;
+        rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        rasterizer.depthBiasEnable = VK_FALSE; // no bias, model pipeline tests against exact depth
+
+        VkPipelineMultisampleStateCreateInfo multisampling = {};
+        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.sampleShadingEnable = VK_FALSE;
+        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+        colorBlendAttachment.colorWriteMask = 0; // depth only
+        colorBlendAttachment.blendEnable = VK_FALSE;
+
+        VkPipelineDepthStencilStateCreateInfo depthStencil = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+        depthStencil.depthTestEnable = VK_TRUE;
+        depthStencil.depthWriteEnable = VK_TRUE;
+        depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+        depthStencil.depthBoundsTestEnable = VK_FALSE;
+        depthStencil.minDepthBounds = 0.0f;
+        depthStencil.maxDepthBounds = 1.0f;
+        depthStencil.stencilTestEnable = VK_FALSE;
+
+        VkPipelineColorBlendStateCreateInfo colorBlending = {};
+        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlending.logicOpEnable = VK_FALSE;
+        colorBlending.logicOp = VK_LOGIC_OP_COPY;
+        colorBlending.attachmentCount = 1;
+        colorBlending.pAttachments = &colorBlendAttachment;
+        
+        // same layout as model pipeline, batches bind the same descriptor set
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {}; 
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &this->descriptors->descriptor_set_layout;
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+
+        if (vkCreatePipelineLayout(this->instance->device, &pipelineLayoutInfo, nullptr, &this->pipeline_layout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+
+        VkGraphicsPipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = 1;
+        pipelineInfo.pStages = &vertShaderStageInfo;
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.pDepthStencilState = &depthStencil;
+        pipelineInfo.layout = pipeline_layout;
+        pipelineInfo.renderPass = *render_pass;
+        pipelineInfo.subpass = 0;
+
+        if (vkCreateGraphicsPipelines(this->instance->device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphics_pipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pipeline!");
+        }else{
+            std::cout<< "Successfully created depth pipeline" << std::endl;
+        }
+
+        vkDestroyShaderModule(this->instance->device, vertShaderModule, nullptr);
+    }
+
+    /// compute pipeline of GPU driven rendering, frustum test and LOD of every instance, writes indirect draws
+    void create_cull_pipeline()
+    {
+        std::vector<char> compShaderCode = read_file("shaders/comp-cull.spv");
+        VkShaderModule compShaderModule = create_shader_module(compShaderCode);
+
+        VkPipelineShaderStageCreateInfo compShaderStageInfo = {};
+        compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        compShaderStageInfo.module = compShaderModule;
+        compShaderStageInfo.pName = "main";
+
+        // same layout as model pipeline, descriptor set is bound once for both
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {}; 
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &this->descriptors->descriptor_set_layout;
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+
+        if (vkCreatePipelineLayout(this->instance->device, &pipelineLayoutInfo, nullptr, &this->pipeline_layout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+
+        VkComputePipelineCreateInfo pipelineInfo = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+        pipelineInfo.stage = compShaderStageInfo;
+        pipelineInfo.layout = pipeline_layout;
+
+        if (vkCreateComputePipelines(this->instance->device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphics_pipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create cull pipeline!");
+        }else{
+            std::cout<< "Successfully created cull pipeline" << std::endl;
+        }
+
+        vkDestroyShaderModule(this->instance->device, compShaderModule, nullptr);
+    }
+
+
 private:
     Instance *instance;
     Descriptors *descriptors;
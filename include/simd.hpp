@@ -0,0 +1,260 @@
+#pragma once
+#include "common.hpp"
+#include <immintrin.h>
+
+//-------------------------------------------------------------------
+// Vectorized attribute/index copies used by loader and per-frame culling.
+// SSE2 is always available on x64, AVX2 path is compiled with `/arch:AVX2`
+
+static_assert(offsetof(Vertex, normal) - offsetof(Vertex, position) >= 16, "vec3 store writes 16 bytes");
+static_assert(offsetof(Vertex, texcoord) - offsetof(Vertex, normal) >= 16, "vec3 store writes 16 bytes");
+
+//-------------------------------------------------------------------
+/// widen `count` 16-bit indices to 32-bit
+
+void widen_indices(const uint16_t* source, uint32_t* destination, size_t count)
+{
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	for(; i + 16 <= count; i += 16){
+		__m256i low  = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(source + i)));
+		__m256i high = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(source + i + 8)));
+		_mm256_storeu_si256((__m256i*)(destination + i), low);
+		_mm256_storeu_si256((__m256i*)(destination + i + 8), high);
+	}
+#endif
+
+	const __m128i zero = _mm_setzero_si128();
+	for(; i + 8 <= count; i += 8){
+		__m128i value = _mm_loadu_si128((const __m128i*)(source + i));
+		_mm_storeu_si128((__m128i*)(destination + i), _mm_unpacklo_epi16(value, zero));
+		_mm_storeu_si128((__m128i*)(destination + i + 4), _mm_unpackhi_epi16(value, zero));
+	}
+
+	for(; i < count; i++) destination[i] = source[i];
+}
+
+/// widen `count` 8-bit indices to 32-bit
+
+void widen_indices(const uint8_t* source, uint32_t* destination, size_t count)
+{
+	size_t i = 0;
+
+	const __m128i zero = _mm_setzero_si128();
+	for(; i + 16 <= count; i += 16){
+		__m128i value = _mm_loadu_si128((const __m128i*)(source + i));
+		__m128i low = _mm_unpacklo_epi8(value, zero);
+		__m128i high = _mm_unpackhi_epi8(value, zero);
+		_mm_storeu_si128((__m128i*)(destination + i), _mm_unpacklo_epi16(low, zero));
+		_mm_storeu_si128((__m128i*)(destination + i + 4), _mm_unpackhi_epi16(low, zero));
+		_mm_storeu_si128((__m128i*)(destination + i + 8), _mm_unpacklo_epi16(high, zero));
+		_mm_storeu_si128((__m128i*)(destination + i + 12), _mm_unpackhi_epi16(high, zero));
+	}
+
+	for(; i < count; i++) destination[i] = source[i];
+}
+
+/// narrow `count` 32-bit indices to 16-bit, every index must be below 65536
+void narrow_indices(const uint32_t* source, uint16_t* destination, size_t count)
+{
+	size_t i = 0;
+
+	// SSE2 only has signed saturating pack, so shift into signed range and back
+	const __m128i bias32 = _mm_set1_epi32(32768);
+	const __m128i bias16 = _mm_set1_epi16(-32768);
+	for(; i + 8 <= count; i += 8){
+		__m128i low = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(source + i)), bias32);
+		__m128i high = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(source + i + 4)), bias32);
+		_mm_storeu_si128((__m128i*)(destination + i), _mm_add_epi16(_mm_packs_epi32(low, high), bias16));
+	}
+
+	for(; i < count; i++) destination[i] = (uint16_t)source[i];
+}
+
+//-------------------------------------------------------------------
+/// copy strided vec3 elements straight into `Vertex` member at `member_offset`
+
+void gather_vec3(const char* source, uint32_t stride, size_t count, Vertex* vertices, size_t member_offset)
+{
+	char* destination = reinterpret_cast<char*>(vertices) + member_offset;
+	size_t i = 0;
+
+	// 16 byte load reads into next element, 16 byte store writes into alignas(16) padding
+	for(; i + 1 < count; i++){
+		__m128 value = _mm_loadu_ps((const float*)(source + i * stride));
+		_mm_storeu_ps((float*)(destination + i * sizeof(Vertex)), value);
+	}
+
+	for(; i < count; i++) std::memcpy(destination + i * sizeof(Vertex), source + i * stride, sizeof(glm::vec3));
+}
+
+/// copy strided vec2 elements straight into `Vertex` member at `member_offset`
+
+void gather_vec2(const char* source, uint32_t stride, size_t count, Vertex* vertices, size_t member_offset)
+{
+	char* destination = reinterpret_cast<char*>(vertices) + member_offset;
+
+	for(size_t i = 0; i < count; i++){
+		__m128i value = _mm_loadl_epi64((const __m128i*)(source + i * stride));
+		_mm_storel_epi64((__m128i*)(destination + i * sizeof(Vertex)), value);
+	}
+}
+
+//-------------------------------------------------------------------
+/// convert strided integer elements to float `Vertex` member, `value * scale` clamped to `minimum` (quantized attributes)
+
+template<typename TYPE>
+void gather_dequantized(const char* source, uint32_t stride, size_t count, uint32_t components, float scale, float minimum, Vertex* vertices, size_t member_offset)
+{
+	char* destination = reinterpret_cast<char*>(vertices) + member_offset;
+
+	for(size_t i = 0; i < count; i++){
+		const char* element = source + i * stride;
+		float* output = reinterpret_cast<float*>(destination + i * sizeof(Vertex));
+
+		for(uint32_t c = 0; c < components; c++){
+			TYPE value;
+			std::memcpy(&value, element + c * sizeof(TYPE), sizeof(TYPE));
+			output[c] = std::max((float)value * scale, minimum);
+		}
+	}
+}
+
+//-------------------------------------------------------------------
+/// frustum test of `count` boxes stored as structure of arrays (min x/y/z, max x/y/z),
+/// `visible[i]` is 1 if box is inside or intersects every plane, 4 boxes per step
+
+void cull_boxes(const float* const bounds[6], size_t count, const Frustum& frustum, uint8_t* visible)
+{
+	// corner furthest along plane normal (positive vertex) is picked per plane, so no per-box select
+	const float* corner[6][3];
+	for(int p = 0; p < 6; p++){
+		for(int axis = 0; axis < 3; axis++) corner[p][axis] = frustum.planes[p][axis] >= 0? bounds[3 + axis] : bounds[axis];
+	}
+
+	size_t i = 0;
+	const __m128 zero = _mm_setzero_ps();
+	for(; i + 4 <= count; i += 4){
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for(int p = 0; p < 6; p++){
+			const glm::vec4& plane = frustum.planes[p];
+			__m128 distance = _mm_set1_ps(plane.w);
+			distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.x), _mm_loadu_ps(corner[p][0] + i)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.y), _mm_loadu_ps(corner[p][1] + i)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.z), _mm_loadu_ps(corner[p][2] + i)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for(int k = 0; k < 4; k++) visible[i + k] = (mask >> k) & 1;
+	}
+
+	for(; i < count; i++){
+		visible[i] = 1;
+		for(int p = 0; p < 6; p++){
+			const glm::vec4& plane = frustum.planes[p];
+			if(plane.x * corner[p][0][i] + plane.y * corner[p][1][i] + plane.z * corner[p][2][i] + plane.w < 0){ visible[i] = 0; break; }
+		}
+	}
+}
+
+//-------------------------------------------------------------------
+/// world bounds of `count` local boxes (Arvo): center is transformed, extent goes through absolute 3x3 matrix,
+/// so rotated boxes stay tight and min/max can't swap
+
+void transform_regions(const Region* local, const glm::mat4* transforms, Region* world, size_t count)
+{
+	const __m128 sign = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+	for(size_t i = 0; i < count; i++){
+		const glm::mat4& m = transforms[i];
+		__m128 column0 = _mm_loadu_ps(&m[0][0]);
+		__m128 column1 = _mm_loadu_ps(&m[1][0]);
+		__m128 column2 = _mm_loadu_ps(&m[2][0]);
+		__m128 column3 = _mm_loadu_ps(&m[3][0]);
+
+		glm::vec3 center = (local[i].min + local[i].max) * 0.5f;
+		glm::vec3 extent = (local[i].max - local[i].min) * 0.5f;
+
+		__m128 world_center = _mm_add_ps(column3, _mm_add_ps(
+			_mm_mul_ps(column0, _mm_set1_ps(center.x)),
+			_mm_add_ps(_mm_mul_ps(column1, _mm_set1_ps(center.y)), _mm_mul_ps(column2, _mm_set1_ps(center.z)))
+		));
+		__m128 world_extent = _mm_add_ps(
+			_mm_mul_ps(_mm_and_ps(column0, sign), _mm_set1_ps(extent.x)),
+			_mm_add_ps(_mm_mul_ps(_mm_and_ps(column1, sign), _mm_set1_ps(extent.y)), _mm_mul_ps(_mm_and_ps(column2, sign), _mm_set1_ps(extent.z)))
+		);
+
+		alignas(16) float min[4], max[4];
+		_mm_store_ps(min, _mm_sub_ps(world_center, world_extent));
+		_mm_store_ps(max, _mm_add_ps(world_center, world_extent));
+		world[i] = Region(glm::vec3(min[0], min[1], min[2]), glm::vec3(max[0], max[1], max[2]));
+	}
+}
+
+Region transform_region(const Region& local, const glm::mat4& transform)
+{
+	Region world;
+	transform_regions(&local, &transform, &world, 1);
+	return world;
+}
+
+//-------------------------------------------------------------------
+/// position bounds of `count` vertices, empty input gives zero region
+
+Region get_position_bounds(const Vertex* vertices, size_t count)
+{
+	if(count == 0) return Region();
+
+	// position is 16 byte aligned member, 4th lane is padding
+	__m128 min = _mm_loadu_ps(&vertices[0].position.x);
+	__m128 max = min;
+	for(size_t i = 1; i < count; i++){
+		__m128 position = _mm_loadu_ps(&vertices[i].position.x);
+		min = _mm_min_ps(min, position);
+		max = _mm_max_ps(max, position);
+	}
+
+	alignas(16) float low[4], high[4];
+	_mm_store_ps(low, min);
+	_mm_store_ps(high, max);
+	return Region(glm::vec3(low[0], low[1], low[2]), glm::vec3(high[0], high[1], high[2]));
+}
+
+/// smallest/largest of `count` floats, 4 lanes per step
+float reduce_min(const float* values, size_t count)
+{
+	if(count == 0) return 0;
+	size_t i = 0;
+	float result = values[0];
+
+	if(count >= 4){
+		__m128 lanes = _mm_loadu_ps(values);
+		for(i = 4; i + 4 <= count; i += 4) lanes = _mm_min_ps(lanes, _mm_loadu_ps(values + i));
+		lanes = _mm_min_ps(lanes, _mm_shuffle_ps(lanes, lanes, _MM_SHUFFLE(1, 0, 3, 2)));
+		lanes = _mm_min_ps(lanes, _mm_shuffle_ps(lanes, lanes, _MM_SHUFFLE(2, 3, 0, 1)));
+		result = _mm_cvtss_f32(lanes);
+	}
+
+	for(; i < count; i++) result = std::min(result, values[i]);
+	return result;
+}
+
+float reduce_max(const float* values, size_t count)
+{
+	if(count == 0) return 0;
+	size_t i = 0;
+	float result = values[0];
+
+	if(count >= 4){
+		__m128 lanes = _mm_loadu_ps(values);
+		for(i = 4; i + 4 <= count; i += 4) lanes = _mm_max_ps(lanes, _mm_loadu_ps(values + i));
+		lanes = _mm_max_ps(lanes, _mm_shuffle_ps(lanes, lanes, _MM_SHUFFLE(1, 0, 3, 2)));
+		lanes = _mm_max_ps(lanes, _mm_shuffle_ps(lanes, lanes, _MM_SHUFFLE(2, 3, 0, 1)));
+		result = _mm_cvtss_f32(lanes);
+	}
+
+	for(; i < count; i++) result = std::max(result, values[i]);
+	return result;
+}
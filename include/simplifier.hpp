@@ -0,0 +1,330 @@
+#pragma once
+#include "common.hpp"
+#include "optimizer.hpp"
+
+//-------------------------------------------------------------------
+// Level of detail generation for `Geometry`.
+// Quadric error metric (Garland-Heckbert) with half-edge collapses: LOD triangles reuse LOD 0 vertices,
+// so every level is only an extra index range appended to `Geometry::indices`.
+// Open border vertices are never removed. Attribute seam vertices (two vertices at one position) collapse
+// as a pair along the seam, each side onto its own vertex, so UV and normal discontinuities stay intact.
+
+const uint32_t LOD_MIN_TRIANGLES = 1024; // smaller geometry has only LOD 0
+const float LOD_RATIO = 0.5f; // triangle count of next level
+const float LOD_MIN_REDUCTION = 0.8f; // stop if level keeps more than this part of previous level
+
+struct Quadric{
+    // symmetric 4x4 matrix of plane equations (a00..a22, b - linear part, c - constant), `weight` - sum of areas
+    // double, so large model coordinates don't cancel out
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0, c = 0;
+    double weight = 0;
+
+    Quadric(){}
+    Quadric(const glm::dvec3& normal, double distance, double area)
+    {
+        a00 = normal.x * normal.x * area; a01 = normal.x * normal.y * area; a02 = normal.x * normal.z * area;
+        a11 = normal.y * normal.y * area; a12 = normal.y * normal.z * area; a22 = normal.z * normal.z * area;
+        b0 = normal.x * distance * area; b1 = normal.y * distance * area; b2 = normal.z * distance * area;
+        c = distance * distance * area;
+        weight = area;
+    }
+
+    void operator+=(const Quadric& q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c;
+        weight += q.weight;
+    }
+
+    /// weighted squared distance of `p` to accumulated planes
+    double error(const glm::dvec3& p) const
+    {
+        double value =
+            a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z +
+            2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z) +
+            2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+        return std::max(value, 0.0);
+    }
+};
+
+//-------------------------------------------------------------------
+
+class Simplifier{
+public:
+
+    /// append LOD index ranges to `geometry.indices` and fill `geometry.lods`, LOD 0 must be the only range
+    static void build_lods(Geometry& geometry)
+    {
+        geometry.lods.assign(1, GeometryLod{ 0, (uint32_t)geometry.indices.size(), 0.0f });
+        if(geometry.indices.size() / 3 < LOD_MIN_TRIANGLES || geometry.indices.size() % 3 != 0) return;
+
+        Simplifier simplifier(geometry);
+        std::vector<uint32_t> indices = geometry.indices;
+        float scale = glm::length(geometry.region.max - geometry.region.min);
+        if(scale <= 0) scale = 1;
+
+        while(geometry.lods.size() < MAX_LODS)
+        {
+            size_t previous = indices.size() / 3;
+            size_t target = (size_t)(previous * LOD_RATIO);
+            float error = simplifier.simplify(indices, target);
+            if(indices.size() / 3 > previous * LOD_MIN_REDUCTION || indices.empty()) break;
+
+            // levels are drawn on their own, so reorder each for vertex cache
+            std::vector<uint32_t> clusters;
+            std::vector<uint32_t> ordered = tipsify(indices, geometry.vertices.size(), VERTEX_CACHE_SIZE, clusters);
+
+            GeometryLod lod;
+            lod.first_index = (uint32_t)geometry.indices.size();
+            lod.index_count = (uint32_t)ordered.size();
+            lod.error = std::max(error / scale, geometry.lods.back().error); // relative to geometry size
+            geometry.indices.insert(geometry.indices.end(), ordered.begin(), ordered.end());
+            geometry.lods.push_back(lod);
+        }
+    }
+
+    /// LODs of every geometry on worker threads
+    static void build_lods(std::vector<std::shared_ptr<Geometry>>& geometries)
+    {
+        parallel_for((uint32_t)geometries.size(), [&](uint32_t i){ build_lods(*geometries[i]); });
+
+        size_t levels = 0;
+        for(std::shared_ptr<Geometry>& geometry : geometries){
+            levels += geometry->lods.size();
+            if(geometry->lods.size() < 2) continue;
+
+            std::string counts;
+            for(const GeometryLod& lod : geometry->lods) counts += std::to_string(lod.index_count / 3) + " ";
+            msg::printl("  LOD triangles: ", counts, "(error ", geometry->lods.back().error * 100, "% of size)");
+        }
+        msg::printl("LOD levels: ", levels, " (", geometries.size(), " primitives)");
+    }
+
+private:
+    const std::vector<Vertex>& vertices;
+    std::vector<Quadric> quadrics; // accumulated over collapses, shared by every level
+    std::vector<uint8_t> locked; // open border, or more than two vertices at position
+    std::vector<uint32_t> wedge; // next vertex at same position (circular list), itself if position is unique
+
+    Simplifier(const Geometry& geometry) : vertices(geometry.vertices)
+    {
+        quadrics.resize(vertices.size());
+        locked.assign(vertices.size(), 0);
+        const std::vector<uint32_t>& indices = geometry.indices;
+
+        for(size_t t = 0; t < indices.size(); t += 3){
+            const glm::vec3& p0 = vertices[indices[t + 0]].position;
+            const glm::vec3& p1 = vertices[indices[t + 1]].position;
+            const glm::vec3& p2 = vertices[indices[t + 2]].position;
+
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(normal);
+            if(area <= 0) continue;
+            normal /= area;
+
+            Quadric quadric(glm::dvec3(normal), -glm::dot(glm::dvec3(normal), glm::dvec3(p0)), area);
+            for(uint32_t k = 0; k < 3; k++) quadrics[indices[t + k]] += quadric;
+        }
+
+        lock_borders(indices);
+    }
+
+    //----------------------------------------------------
+    /// link vertices at same position, lock open edges (found on position welded topology) and seam junctions
+
+    void lock_borders(const std::vector<uint32_t>& indices)
+    {
+        std::map<std::tuple<float, float, float>, uint32_t> positions;
+        std::vector<uint32_t> welded(vertices.size());
+        wedge.resize(vertices.size());
+        for(size_t v = 0; v < vertices.size(); v++){
+            const glm::vec3& p = vertices[v].position;
+            auto result = positions.emplace(std::make_tuple(p.x, p.y, p.z), (uint32_t)v);
+            uint32_t first = result.first->second;
+            welded[v] = first;
+            wedge[v] = wedge[first]; // insert after first vertex of position
+            wedge[first] = (uint32_t)v;
+        }
+
+        // seam pair has exactly two vertices, where more seams meet the position can't move
+        for(size_t v = 0; v < vertices.size(); v++){
+            if(welded[v] != v || wedge[wedge[v]] == v) continue;
+            uint32_t w = (uint32_t)v;
+            do{ locked[w] = 1; w = wedge[w]; }while(w != v);
+        }
+
+        // edge used by single triangle (either direction) is border
+        std::vector<std::pair<uint32_t, uint32_t>> edges;
+        edges.reserve(indices.size());
+        for(size_t t = 0; t < indices.size(); t += 3){
+            for(uint32_t k = 0; k < 3; k++){
+                uint32_t a = welded[indices[t + k]], b = welded[indices[t + (k + 1) % 3]];
+                edges.emplace_back(std::min(a, b), std::max(a, b));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        std::vector<uint8_t> border(vertices.size(), 0);
+        for(size_t i = 0; i < edges.size();){
+            size_t j = i;
+            while(j < edges.size() && edges[j] == edges[i]) j++;
+            if(j - i == 1){ border[edges[i].first] = 1; border[edges[i].second] = 1; }
+            i = j;
+        }
+        for(size_t v = 0; v < vertices.size(); v++) if(border[welded[v]]) locked[v] = 1;
+    }
+
+    //----------------------------------------------------
+    /// collapse edges until `indices` has at most `target` triangles or nothing can collapse, returns max error (distance)
+
+    float simplify(std::vector<uint32_t>& indices, size_t target)
+    {
+        float max_error = 0;
+        std::vector<uint32_t> remap(vertices.size());
+        std::vector<uint8_t> touched(vertices.size());
+
+        for(uint32_t pass = 0; pass < 100 && indices.size() / 3 > target; pass++)
+        {
+            // vertex -> triangle adjacency (CSR)
+            std::vector<uint32_t> offsets(vertices.size() + 1, 0);
+            for(uint32_t index : indices) offsets[index + 1]++;
+            for(size_t v = 0; v < vertices.size(); v++) offsets[v + 1] += offsets[v];
+            std::vector<uint32_t> adjacency(indices.size());
+            std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+            for(size_t i = 0; i < indices.size(); i++) adjacency[cursor[indices[i]]++] = (uint32_t)(i / 3);
+
+            // cheapest direction of every edge, seam vertex takes its twin along
+            struct Collapse{ uint32_t from, to, twin_from, twin_to; float error; };
+            auto evaluate = [&](uint32_t from, uint32_t to){
+                Collapse collapse = { from, to, from, to, FLT_MAX };
+                if(locked[from] || wedge[from] == to) return collapse;
+                if(wedge[from] == from){
+                    collapse.error = collapse_error(from, to);
+                    return collapse;
+                }
+
+                uint32_t twin_to = get_twin_target(indices, offsets, adjacency, from, to);
+                if(twin_to == UINT32_MAX) return collapse; // edge leaves the seam, one side would tear
+                collapse.twin_from = wedge[from];
+                collapse.twin_to = twin_to;
+                collapse.error = std::max(collapse_error(from, to), collapse_error(collapse.twin_from, twin_to));
+                return collapse;
+            };
+
+            std::vector<Collapse> collapses;
+            collapses.reserve(indices.size());
+            for(size_t t = 0; t < indices.size(); t += 3){
+                for(uint32_t k = 0; k < 3; k++){
+                    uint32_t a = indices[t + k], b = indices[t + (k + 1) % 3];
+                    if(a > b) continue; // each undirected edge once per triangle side
+                    Collapse ab = evaluate(a, b);
+                    Collapse ba = evaluate(b, a);
+                    if(ab.error == FLT_MAX && ba.error == FLT_MAX) continue;
+                    collapses.push_back(ab.error <= ba.error? ab : ba);
+                }
+            }
+            if(collapses.empty()) break;
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y){ return x.error < y.error; });
+
+            for(size_t v = 0; v < vertices.size(); v++) remap[v] = (uint32_t)v;
+            std::fill(touched.begin(), touched.end(), 0);
+
+            // ring of `from` is fixed for this pass, so flip test of later collapses stays valid
+            auto apply = [&](uint32_t from, uint32_t to){
+                size_t removed = 0;
+                for(uint32_t i = offsets[from]; i < offsets[from + 1]; i++){
+                    uint32_t t = adjacency[i];
+                    bool has_to = false;
+                    for(uint32_t k = 0; k < 3; k++){
+                        touched[indices[t * 3 + k]] = 1;
+                        has_to |= indices[t * 3 + k] == to;
+                    }
+                    removed += has_to;
+                }
+                remap[from] = to;
+                quadrics[to] += quadrics[from];
+                return removed;
+            };
+
+            size_t triangles = indices.size() / 3;
+            size_t performed = 0;
+            for(const Collapse& collapse : collapses)
+            {
+                if(triangles <= target) break;
+                bool is_seam = collapse.twin_from != collapse.from;
+                if(touched[collapse.from] || touched[collapse.to] || touched[collapse.twin_from] || touched[collapse.twin_to]) continue;
+                if(is_flipped(indices, offsets, adjacency, collapse.from, collapse.to)) continue;
+                if(is_seam && is_flipped(indices, offsets, adjacency, collapse.twin_from, collapse.twin_to)) continue;
+
+                size_t removed = apply(collapse.from, collapse.to);
+                if(is_seam) removed += apply(collapse.twin_from, collapse.twin_to);
+
+                max_error = std::max(max_error, collapse.error);
+                triangles -= removed;
+                performed++;
+            }
+            if(performed == 0) break;
+
+            // apply collapses, drop degenerate triangles
+            size_t write = 0;
+            for(size_t t = 0; t < indices.size(); t += 3){
+                uint32_t a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+                if(a == b || b == c || a == c) continue;
+                indices[write++] = a; indices[write++] = b; indices[write++] = c;
+            }
+            indices.resize(write);
+        }
+
+        return std::sqrt(max_error);
+    }
+
+    /// squared distance error of moving `from` onto `to`
+    float collapse_error(uint32_t from, uint32_t to) const
+    {
+        Quadric quadric = quadrics[from];
+        quadric += quadrics[to];
+        return quadric.weight > 0? (float)(quadric.error(glm::dvec3(vertices[to].position)) / quadric.weight) : 0.0f;
+    }
+
+    /// vertex at `to` position that the twin of seam vertex `from` shares an edge with (same seam edge on the other side),
+    /// each side keeps its own attributes, UINT32_MAX if the twin has no such edge
+    uint32_t get_twin_target(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& adjacency, uint32_t from, uint32_t to) const
+    {
+        uint32_t twin = wedge[from];
+
+        for(uint32_t i = offsets[twin]; i < offsets[twin + 1]; i++){
+            const uint32_t* triangle = &indices[adjacency[i] * 3];
+            for(uint32_t k = 0; k < 3; k++){
+                uint32_t w = to;
+                do{
+                    if(triangle[k] == w) return w;
+                    w = wedge[w];
+                }while(w != to);
+            }
+        }
+        return UINT32_MAX;
+    }
+
+    /// true if any triangle around `from` that survives the collapse would turn over
+    bool is_flipped(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& adjacency, uint32_t from, uint32_t to) const
+    {
+        const glm::vec3& target = vertices[to].position;
+
+        for(uint32_t i = offsets[from]; i < offsets[from + 1]; i++){
+            const uint32_t* triangle = &indices[adjacency[i] * 3];
+            if(triangle[0] == to || triangle[1] == to || triangle[2] == to) continue; // removed by collapse
+
+            glm::vec3 p[3], q[3];
+            for(uint32_t k = 0; k < 3; k++){
+                p[k] = vertices[triangle[k]].position;
+                q[k] = triangle[k] == from? target : p[k];
+            }
+
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+            if(glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after)) return true; // flip or > ~75 degree turn
+        }
+        return false;
+    }
+};
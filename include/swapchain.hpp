@@ -44,6 +44,7 @@ public:
     std::vector<VkSemaphore> image_available_semaphores;
     std::vector<VkSemaphore> render_finished_semaphores;
     std::vector<VkFence> in_flight_fences;
+    std::vector<VkFence> images_in_flight; // fence of frame that last used the image (and its command buffer)
 
     //------------------------------------------------------------
 
@@ -145,6 +146,7 @@ public:
         image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
         render_finished_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
         in_flight_fences.resize(MAX_FRAMES_IN_FLIGHT);
+        images_in_flight.assign(swapchain_images.size(), VK_NULL_HANDLE);
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
             VkSemaphoreCreateInfo semaphoreInfo = {};
@@ -191,6 +193,13 @@ public:
             throw std::runtime_error("failed to acquire swap chain image!");
         }
 
+        // command buffer of this image can be re-recorded only after its previous submit finished
+        // (current frame fence is already waited and reset above)
+        if(images_in_flight[index] != VK_NULL_HANDLE && images_in_flight[index] != in_flight_fences[current_frame]){
+            vkWaitForFences(instance->device, 1, &images_in_flight[index], VK_TRUE, UINT64_MAX);
+        }
+        images_in_flight[index] = in_flight_fences[current_frame];
+
         return image_index;
     }
 
@@ -212,6 +221,7 @@ public:
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
+        std::lock_guard<std::mutex> lock(instance->queue_mutex);
         if (vkQueueSubmit(instance->queues.graphics_queue, 1, &submitInfo, in_flight_fences[current_frame]) != VK_SUCCESS) { 
             throw std::runtime_error("failed to submit draw command buffer!");
         }
@@ -0,0 +1,145 @@
+#pragma once
+#include "common.hpp"
+
+//-------------------------------------------------------------------
+// Tangent space generation for `Geometry`.
+// Triangle tangents are area weighted, accumulated per vertex through vertex -> triangle
+// adjacency (no atomics), then orthonormalized against vertex normal (Gram-Schmidt).
+
+const uint32_t TANGENT_CHUNK = 16384; // triangles/vertices per job
+
+struct TangentWork{
+    std::vector<glm::vec3> tangents; // per triangle, already weighted
+    std::vector<glm::vec3> bitangents;
+    std::vector<uint32_t> offsets; // vertex -> first entry in `triangles`
+    std::vector<uint32_t> triangles;
+};
+
+//-------------------------------------------------------------------
+/// tangent/bitangent of triangles [begin, end), degenerate UVs give zero contribution
+
+void compute_triangle_tangents(const Geometry& geometry, TangentWork& work, size_t begin, size_t end)
+{
+    const std::vector<uint32_t>& indices = geometry.indices;
+    const std::vector<Vertex>& vertices = geometry.vertices;
+
+    for(size_t t = begin; t < end; t++)
+    {
+        const Vertex& v0 = vertices[indices[t*3 + 0]];
+        const Vertex& v1 = vertices[indices[t*3 + 1]];
+        const Vertex& v2 = vertices[indices[t*3 + 2]];
+
+        glm::vec3 pos1 = v1.position - v0.position;
+        glm::vec3 pos2 = v2.position - v0.position;
+        glm::vec2 uv1 = v1.texcoord - v0.texcoord;
+        glm::vec2 uv2 = v2.texcoord - v0.texcoord;
+
+        glm::vec3 tangent(0), bitangent(0);
+        float det = uv1.x * uv2.y - uv1.y * uv2.x;
+
+        if(std::abs(det) > 1e-12f){
+            float r = 1.0f / det;
+            tangent = (pos1 * uv2.y - pos2 * uv1.y) * r;
+            bitangent = (pos2 * uv1.x - pos1 * uv2.x) * r;
+
+            // weight by triangle area, so UV scale doesn't matter
+            float area = glm::length(glm::cross(pos1, pos2));
+            float tangent_length = glm::length(tangent);
+            float bitangent_length = glm::length(bitangent);
+            tangent = tangent_length > 0? tangent * (area / tangent_length) : glm::vec3(0);
+            bitangent = bitangent_length > 0? bitangent * (area / bitangent_length) : glm::vec3(0);
+        }
+
+        work.tangents[t] = tangent;
+        work.bitangents[t] = bitangent;
+    }
+}
+
+/// vertex -> triangle adjacency (CSR), so each vertex can sum its triangles without write conflicts
+void build_vertex_triangles(const Geometry& geometry, TangentWork& work, size_t triangle_count)
+{
+    const std::vector<uint32_t>& indices = geometry.indices;
+    size_t vertex_count = geometry.vertices.size();
+
+    work.offsets.assign(vertex_count + 1, 0);
+    for(size_t i = 0; i < triangle_count * 3; i++){
+        if(indices[i] >= vertex_count) throw std::runtime_error("index is out of vertex range");
+        work.offsets[indices[i] + 1]++;
+    }
+    for(size_t v = 0; v < vertex_count; v++) work.offsets[v + 1] += work.offsets[v];
+
+    std::vector<uint32_t> cursor(work.offsets.begin(), work.offsets.end() - 1);
+    work.triangles.resize(triangle_count * 3);
+    for(size_t i = 0; i < triangle_count * 3; i++) work.triangles[cursor[indices[i]]++] = (uint32_t)(i / 3);
+}
+
+/// sum triangle tangents of vertices [begin, end) and orthonormalize against normal
+void accumulate_vertex_tangents(Geometry& geometry, const TangentWork& work, size_t begin, size_t end)
+{
+    for(size_t v = begin; v < end; v++)
+    {
+        glm::vec3 tangent(0), bitangent(0);
+        for(uint32_t i = work.offsets[v]; i < work.offsets[v + 1]; i++){
+            tangent += work.tangents[work.triangles[i]];
+            bitangent += work.bitangents[work.triangles[i]];
+        }
+
+        Vertex& vertex = geometry.vertices[v];
+        glm::vec3 normal = glm::dot(vertex.normal, vertex.normal) > 0? glm::normalize(vertex.normal) : glm::vec3(0, 0, 1);
+
+        // Gram-Schmidt, fallback to any direction perpendicular to normal
+        tangent -= normal * glm::dot(normal, tangent);
+        if(glm::dot(tangent, tangent) < 1e-20f){
+            tangent = glm::cross(normal, std::abs(normal.x) < 0.9f? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0));
+        }
+        tangent = glm::normalize(tangent);
+
+        // keep handedness of UV mapping
+        glm::vec3 cross = glm::cross(normal, tangent);
+        vertex.tangent = tangent;
+        vertex.bitangent = glm::dot(cross, bitangent) < 0? -cross : cross;
+    }
+}
+
+//-------------------------------------------------------------------
+/// tangents of single geometry, `parallel` splits triangle/vertex ranges over worker threads
+
+void generate_tangents(Geometry& geometry, bool parallel)
+{
+    size_t triangle_count = geometry.indices.size() / 3;
+    size_t vertex_count = geometry.vertices.size();
+
+    TangentWork work;
+    work.tangents.resize(triangle_count);
+    work.bitangents.resize(triangle_count);
+    build_vertex_triangles(geometry, work, triangle_count);
+
+    if(parallel){
+        uint32_t chunks = (uint32_t)((triangle_count + TANGENT_CHUNK - 1) / TANGENT_CHUNK);
+        parallel_for(chunks, [&](uint32_t chunk){
+            compute_triangle_tangents(geometry, work, (size_t)chunk * TANGENT_CHUNK, std::min(triangle_count, (size_t)(chunk + 1) * TANGENT_CHUNK));
+        });
+
+        chunks = (uint32_t)((vertex_count + TANGENT_CHUNK - 1) / TANGENT_CHUNK);
+        parallel_for(chunks, [&](uint32_t chunk){
+            accumulate_vertex_tangents(geometry, work, (size_t)chunk * TANGENT_CHUNK, std::min(vertex_count, (size_t)(chunk + 1) * TANGENT_CHUNK));
+        });
+    }else{
+        compute_triangle_tangents(geometry, work, 0, triangle_count);
+        accumulate_vertex_tangents(geometry, work, 0, vertex_count);
+    }
+}
+
+/// tangents of all geometry without TANGENT attribute, small meshes run one per thread, large meshes are split
+void generate_tangents(std::vector<std::shared_ptr<Geometry>>& geometries)
+{
+    std::vector<Geometry*> small, large;
+    for(std::shared_ptr<Geometry>& geometry : geometries){
+        if(geometry->has_tangents) continue;
+        if(geometry->indices.size() / 3 > TANGENT_CHUNK * 4) large.push_back(geometry.get());
+        else small.push_back(geometry.get());
+    }
+
+    parallel_for((uint32_t)small.size(), [&](uint32_t i){ generate_tangents(*small[i], false); });
+    for(Geometry* geometry : large) generate_tangents(*geometry, true);
+}
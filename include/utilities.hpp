@@ -35,6 +35,128 @@ std::vector<char> read_file(const std::string &filename)
 	return buffer;
 }
 
+//-------------------------------------------------------------------
+/// decode base64 text (padding and whitespace are skipped)
+std::vector<char> decode_base64(const char* text, size_t length)
+{
+	auto value = [](char c) -> int {
+		if(c >= 'A' && c <= 'Z') return c - 'A';
+		if(c >= 'a' && c <= 'z') return c - 'a' + 26;
+		if(c >= '0' && c <= '9') return c - '0' + 52;
+		if(c == '+' || c == '-') return 62;
+		if(c == '/' || c == '_') return 63;
+		return -1;
+	};
+
+	std::vector<char> bytes;
+	bytes.reserve(length / 4 * 3);
+
+	uint32_t bits = 0;
+	int count = 0;
+	for(size_t i = 0; i < length; i++){
+		if(text[i] == '=') break;
+		int v = value(text[i]);
+		if(v < 0){
+			if(std::isspace((unsigned char)text[i])) continue;
+			throw std::runtime_error("invalid base64 character");
+		}
+
+		bits = (bits << 6) | (uint32_t)v;
+		count += 6;
+		if(count >= 8){
+			count -= 8;
+			bytes.push_back((char)((bits >> count) & 0xFF));
+		}
+	}
+	return bytes;
+}
+
+//-------------------------------------------------------------------
+/// read-only memory mapped file, `data` is valid until `unmap()` (no copy into RAM)
+
+class MappedFile
+{
+public:
+	const char* data = nullptr;
+	size_t size = 0;
+
+	MappedFile(){};
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile(){ unmap(); }
+
+	void map(const std::string &filename)
+	{
+		unmap();
+
+		file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if(file == INVALID_HANDLE_VALUE){
+			file = nullptr;
+			throw std::runtime_error(std::string("failed to open file - " + filename));
+		}
+
+		LARGE_INTEGER file_size = {};
+		GetFileSizeEx(file, &file_size);
+		this->size = (size_t)file_size.QuadPart;
+		if(this->size == 0){
+			unmap();
+			throw std::runtime_error(std::string("file is empty - " + filename));
+		}
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if(mapping != nullptr) this->data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+		if(this->data == nullptr){
+			unmap();
+			throw std::runtime_error(std::string("failed to map file - " + filename));
+		}
+	}
+
+	void unmap()
+	{
+		if(data != nullptr) UnmapViewOfFile(data);
+		if(mapping != nullptr) CloseHandle(mapping);
+		if(file != nullptr) CloseHandle(file);
+
+		data = nullptr;
+		mapping = nullptr;
+		file = nullptr;
+		size = 0;
+	}
+
+private:
+	HANDLE file = nullptr;
+	HANDLE mapping = nullptr;
+};
+
+//-------------------------------------------------------------------
+/// run `job(i)` for every `i` in [0, count) on hardware threads, returns when all jobs are done
+
+void parallel_for(uint32_t count, const std::function<void(uint32_t)> &job)
+{
+	uint32_t thread_count = std::min<uint32_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+	std::atomic<uint32_t> next = 0;
+	std::exception_ptr error = nullptr;
+	std::atomic<bool> failed = false;
+
+	auto work = [&](){
+		for(uint32_t i = next++; i < count && !failed; i = next++){
+			try{
+				job(i);
+			}catch(...){
+				if(!failed.exchange(true)) error = std::current_exception();
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for(uint32_t i = 1; i < thread_count; i++) workers.emplace_back(work);
+	work(); // calling thread is a worker too
+	for(std::thread &worker : workers) worker.join();
+
+	if(error) std::rethrow_exception(error);
+}
+
 //-------------------------------------------------------------------
 
 uint64_t timestamp_milli()
@@ -55,6 +177,19 @@ uint64_t timestamp_nano()
 	return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
 }
 
+//-------------------------------------------------------------------
+/// `Vertex` without position, second vertex stream (binding 1) in GPU memory
+
+struct VertexAttributes
+{
+	glm::vec3 normal;
+	glm::vec2 texcoord;
+	glm::vec3 tangent;
+	glm::vec3 bitangent;
+};
+
+static_assert(sizeof(VertexAttributes) == 44, "vertex attribute stream layout");
+
 //-------------------------------------------------------------------
 /// Position, normal, texture
 
@@ -75,12 +210,17 @@ struct Vertex
 	alignas(16) glm::vec3 bitangent;
 
 	/// buffer binding indices, tells `attribute locations` what buffer to use
-	static VkVertexInputBindingDescription get_binding_description() {
-		VkVertexInputBindingDescription description = {};
-		description.binding = 0;
-		description.stride = sizeof(Vertex);
-		description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		return description;
+	/// 0 - tightly packed positions (depth pipeline binds only this one), 1 - `VertexAttributes`
+	static std::array<VkVertexInputBindingDescription, 2> get_binding_descriptions() {
+		std::array<VkVertexInputBindingDescription, 2> descriptions = {};
+		descriptions[0].binding = 0;
+		descriptions[0].stride = sizeof(glm::vec3);
+		descriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		descriptions[1].binding = 1;
+		descriptions[1].stride = sizeof(VertexAttributes);
+		descriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return descriptions;
 	};
 
 	/// location attributes for vertex shader
@@ -90,27 +230,27 @@ struct Vertex
 		descriptions[0].binding = 0;
 		descriptions[0].location = 0;
 		descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		descriptions[0].offset = offsetof(Vertex, position);
+		descriptions[0].offset = 0;
 
-		descriptions[1].binding = 0;
+		descriptions[1].binding = 1;
 		descriptions[1].location = 1;
 		descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		descriptions[1].offset = offsetof(Vertex, normal);
+		descriptions[1].offset = offsetof(VertexAttributes, normal);
 
-		descriptions[2].binding = 0;
+		descriptions[2].binding = 1;
 		descriptions[2].location = 2;
 		descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		descriptions[2].offset = offsetof(Vertex, texcoord);
+		descriptions[2].offset = offsetof(VertexAttributes, texcoord);
 
-		descriptions[3].binding = 0;
+		descriptions[3].binding = 1;
 		descriptions[3].location = 3;
 		descriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-		descriptions[3].offset = offsetof(Vertex, tangent);
+		descriptions[3].offset = offsetof(VertexAttributes, tangent);
 
-		descriptions[4].binding = 0;
+		descriptions[4].binding = 1;
 		descriptions[4].location = 4;
 		descriptions[4].format = VK_FORMAT_R32G32B32_SFLOAT;
-		descriptions[4].offset = offsetof(Vertex, bitangent);
+		descriptions[4].offset = offsetof(VertexAttributes, bitangent);
 
 		return descriptions;
 	};
@@ -129,6 +269,29 @@ struct UniformPropertiesStruct{
 	alignas(4) int map = 0;
 };
 
+struct UniformCullingStruct{ // comp-cull.comp input, written every frame
+	alignas(16) glm::vec4 planes[6]; // frustum
+	alignas(16) glm::vec3 camera = glm::vec3(0);
+	alignas(4) float pixel_scale = 1.0f; // pixels per world unit at distance 1
+	alignas(4) uint32_t draw_count = 0;
+	alignas(4) uint32_t short_draw_count = 0; // first draws use 16-bit index buffer
+	alignas(4) uint32_t compact = 0; // 1 - visible commands are packed and counted (indirect count), 0 - culled commands get zero instances
+	alignas(4) float lod_error = 1.0f; // LOD_PIXEL_ERROR
+};
+
+struct IndirectDrawStruct{ // one per instance (std430), culled and turned into VkDrawIndexedIndirectCommand by comp-cull.comp
+	alignas(16) glm::vec3 region_min = glm::vec3(0); // world region
+	alignas(4) uint32_t slot = 0; // material in material buffer
+	alignas(16) glm::vec3 region_max = glm::vec3(0);
+	alignas(4) uint32_t lod_count = 1;
+	alignas(4) int32_t vertex_offset = 0;
+	alignas(4) uint32_t index_offset = 0;
+	alignas(4) uint32_t padding[2] = {};
+	alignas(4) uint32_t first_index[MAX_LODS] = {}; // relative to index_offset
+	alignas(4) uint32_t index_count[MAX_LODS] = {};
+	alignas(4) float error[MAX_LODS] = {};
+};
+
 struct Region{
 	Region(){};
 	Region(glm::vec3 min, glm::vec3 max){
@@ -140,6 +303,140 @@ struct Region{
 	glm::vec3 max = glm::vec3(0);
 };
 
+/// view frustum planes (xyz - inward normal, w - distance), extracted from projection * view (depth 0..1)
+struct Frustum{
+	glm::vec4 planes[6];
+
+	Frustum(const glm::mat4& m){
+		glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+		glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+		glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+		glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+		planes[0] = row3 + row0; // left
+		planes[1] = row3 - row0; // right
+		planes[2] = row3 + row1; // bottom
+		planes[3] = row3 - row1; // top
+		planes[4] = row2;        // near
+		planes[5] = row3 - row2; // far
+		for(glm::vec4& plane : planes) plane /= glm::length(glm::vec3(plane));
+	}
+
+	bool intersects(const glm::vec3& center, float radius) const {
+		for(const glm::vec4& plane : planes){
+			if(glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+		}
+		return true;
+	}
+
+	/// box corner furthest along plane normal (positive vertex) is in front of every plane
+	bool intersects(const Region& region) const {
+		for(const glm::vec4& plane : planes){
+			glm::vec3 corner(plane.x >= 0? region.max.x : region.min.x, plane.y >= 0? region.max.y : region.min.y, plane.z >= 0? region.max.z : region.min.z);
+			if(glm::dot(glm::vec3(plane), corner) + plane.w < 0) return false;
+		}
+		return true;
+	}
+
+	/// nearest corner (negative vertex) is in front of every plane, whole box is inside
+	bool contains(const Region& region) const {
+		for(const glm::vec4& plane : planes){
+			glm::vec3 corner(plane.x >= 0? region.min.x : region.max.x, plane.y >= 0? region.min.y : region.max.y, plane.z >= 0? region.min.z : region.max.z);
+			if(glm::dot(glm::vec3(plane), corner) + plane.w < 0) return false;
+		}
+		return true;
+	}
+};
+
+//-------------------------------------------------------------------
+/// unit vector to octahedral map coordinates in [-1, 1], zero vector maps to +Z
+glm::vec2 octahedral_encode(glm::vec3 v)
+{
+	float sum = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+	if(sum == 0) return glm::vec2(0);
+	v /= sum;
+
+	if(v.z >= 0) return glm::vec2(v.x, v.y);
+	return glm::vec2(
+		(1.0f - std::abs(v.y)) * (v.x >= 0? 1.0f : -1.0f),
+		(1.0f - std::abs(v.x)) * (v.y >= 0? 1.0f : -1.0f)
+	);
+}
+
+/// compact vertex (20 bytes instead of 80), decoded in `vert-model-packed.vert`
+struct PackedVertex
+{
+	uint16_t position[4]; // unorm16 inside geometry region, w - bitangent sign (0 negative, 1 positive)
+	int16_t normal[2]; // octahedral snorm16
+	int16_t tangent[2]; // octahedral snorm16, bitangent = cross(normal, tangent) * sign
+	uint16_t texcoord[2]; // half float
+
+	static PackedVertex pack(const Vertex& vertex, const Region& region)
+	{
+		PackedVertex packed;
+		glm::vec3 extent = region.max - region.min;
+		for(int i = 0; i < 3; i++){
+			float value = extent[i] > 0? (vertex.position[i] - region.min[i]) / extent[i] : 0.0f;
+			packed.position[i] = (uint16_t)std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f);
+		}
+		float handedness = glm::dot(glm::cross(vertex.normal, vertex.tangent), vertex.bitangent);
+		packed.position[3] = handedness < 0? 0 : 65535;
+
+		glm::vec2 normal = octahedral_encode(vertex.normal);
+		glm::vec2 tangent = octahedral_encode(vertex.tangent);
+		for(int i = 0; i < 2; i++){
+			packed.normal[i] = (int16_t)std::lround(std::clamp(normal[i], -1.0f, 1.0f) * 32767.0f);
+			packed.tangent[i] = (int16_t)std::lround(std::clamp(tangent[i], -1.0f, 1.0f) * 32767.0f);
+			packed.texcoord[i] = (uint16_t)glm::packHalf1x16(vertex.texcoord[i]);
+		}
+		return packed;
+	}
+
+	/// 0 - position stream (8 bytes), 1 - normal, tangent, texcoord (12 bytes), same split as `Vertex`
+	static std::array<VkVertexInputBindingDescription, 2> get_binding_descriptions() {
+		std::array<VkVertexInputBindingDescription, 2> descriptions = {};
+		descriptions[0].binding = 0;
+		descriptions[0].stride = sizeof(PackedVertex::position);
+		descriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		descriptions[1].binding = 1;
+		descriptions[1].stride = sizeof(PackedVertex) - sizeof(PackedVertex::position);
+		descriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return descriptions;
+	};
+
+	/// same locations as `Vertex`, bitangent (4) is rebuilt in shader
+	static std::array<VkVertexInputAttributeDescription, 4> get_attribute_descriptions() {
+		std::array<VkVertexInputAttributeDescription, 4> descriptions = {};
+		const uint32_t stream_offset = sizeof(PackedVertex::position); // attributes follow position in struct
+
+		descriptions[0].binding = 0;
+		descriptions[0].location = 0;
+		descriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+		descriptions[0].offset = 0;
+
+		descriptions[1].binding = 1;
+		descriptions[1].location = 1;
+		descriptions[1].format = VK_FORMAT_R16G16_SNORM;
+		descriptions[1].offset = offsetof(PackedVertex, normal) - stream_offset;
+
+		descriptions[2].binding = 1;
+		descriptions[2].location = 2;
+		descriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+		descriptions[2].offset = offsetof(PackedVertex, texcoord) - stream_offset;
+
+		descriptions[3].binding = 1;
+		descriptions[3].location = 3;
+		descriptions[3].format = VK_FORMAT_R16G16_SNORM;
+		descriptions[3].offset = offsetof(PackedVertex, tangent) - stream_offset;
+
+		return descriptions;
+	};
+};
+
+static_assert(sizeof(PackedVertex) == 20, "packed vertex layout");
+static_assert(offsetof(PackedVertex, normal) == sizeof(PackedVertex::position), "attribute stream is copied from `normal` to end");
+
 // alignas(); // https://www.khronos.org/registry/vulkan/specs/1.1-extensions/html/chap14.html#interfaces-resources-layout
 // scalar - byte size (uint16 2, uint32 4, float 4, double 8)
 // vec2 - 8
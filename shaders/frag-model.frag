@@ -3,12 +3,15 @@
 
 const float PI = 3.14159265359;
 
+layout(constant_id = 0) const bool GPU_DRIVEN = false; // material comes from material buffer, not from dynamic uniform
+
 //-----------------------------------------------------------------
 
 layout(location = 0) in vec2 inTexcoord;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec3 inPosition;
 layout(location = 3) in vec3 inViewPos;
+layout(location = 9) flat in uint inMaterial; // GPU_DRIVEN only, constant per indirect draw, so texture indices stay dynamically uniform
 
 layout(location = 0) out vec4 outColor;
 
@@ -18,7 +21,7 @@ layout(binding = 1) uniform Properties {
     int map;
 } properties;
 
-layout(binding = 2) uniform Mesh {
+struct MeshData { // UniformMeshStruct
     mat4 cframe;
     vec3 base_color;
     vec3 emission_factor;
@@ -28,7 +31,17 @@ layout(binding = 2) uniform Mesh {
     int normal_id;
     int material_id;
     int emission_id;
-} mesh;
+    vec3 region_min; // packed vertex position bounds
+    vec3 region_extent;
+};
+
+layout(binding = 2) uniform Mesh {
+    MeshData data;
+} batch;
+
+layout(std430, binding = 12) readonly buffer Materials {
+    MeshData materials[];
+};
 
 layout(binding = 3) uniform sampler2D enviroment_sampler;
 layout(binding = 4) uniform sampler2D albedo_sampler[32];
@@ -98,6 +111,7 @@ void main() {
     const float gamma = 2.2;
     const float exposure = .3;
     vec3 light_color = vec3(1.0);
+    MeshData mesh = GPU_DRIVEN? materials[inMaterial] : batch.data;
     
     vec3 albedo = mesh.albedo_id == -1? mesh.base_color : texture(albedo_sampler[mesh.albedo_id], inTexcoord).rgb;
     albedo = pow(albedo, vec3(gamma));
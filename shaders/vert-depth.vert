@@ -0,0 +1,56 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(constant_id = 0) const bool GPU_DRIVEN = false; // region is read from material of draw, indexed by gl_InstanceIndex
+
+// position stream: float position, or unorm16 packed position inside mesh region
+layout(location = 0) in vec3 inPosition;
+
+layout(binding = 0) uniform Camera {
+    mat4 view;
+    mat4 proj;
+} camera;
+
+struct MeshData { // UniformMeshStruct
+    mat4 cframe;
+    vec3 base_color;
+    vec3 emission_factor;
+    float roughness;
+    float metalliness;
+    int albedo_id;
+    int normal_id;
+    int material_id;
+    int emission_id;
+    vec3 region_min; // zero for float positions
+    vec3 region_extent; // one for float positions
+};
+
+layout(binding = 2) uniform Mesh {
+    MeshData data;
+} batch;
+
+layout(std430, binding = 8) readonly buffer Instances {
+    mat4 cframes[];
+} instances;
+
+struct Draw { // IndirectDrawStruct, only material slot is used
+    vec3 region_min;
+    uint slot;
+    vec4 unused[5];
+};
+
+layout(std430, binding = 9) readonly buffer Draws {
+    Draw draws[]; // indexed by gl_InstanceIndex, one draw per instance
+};
+
+layout(std430, binding = 12) readonly buffer Materials {
+    MeshData materials[];
+};
+
+invariant gl_Position; // model pipeline tests against this depth with LESS_OR_EQUAL
+
+void main() {
+    MeshData mesh = GPU_DRIVEN? materials[draws[gl_InstanceIndex].slot] : batch.data;
+    vec3 position = mesh.region_min + inPosition * mesh.region_extent;
+    gl_Position = camera.proj * camera.view * instances.cframes[gl_InstanceIndex] * vec4(position, 1.0);
+}
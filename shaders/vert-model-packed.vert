@@ -0,0 +1,101 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(constant_id = 0) const bool GPU_DRIVEN = false; // material slot is read from draw buffer by gl_InstanceIndex
+
+// PackedVertex
+layout(location = 0) in vec4 packedPosition; // unorm16 inside mesh region, w - bitangent sign
+layout(location = 1) in vec2 packedNormal; // octahedral
+layout(location = 2) in vec2 inTexcoord; // half float
+layout(location = 3) in vec2 packedTangent; // octahedral
+
+layout(location = 0) out vec2 outTexcoord;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec3 outPosition;
+layout(location = 3) out vec3 outViewPos;
+layout(location = 4) out outTangentSpace{
+    mat3 TBN;
+    vec3 viewPos;
+    vec3 fragPos;
+} tan_space;
+layout(location = 9) flat out uint outMaterial; // GPU_DRIVEN only
+
+layout(binding = 0) uniform Camera {
+    mat4 view;
+    mat4 proj;
+} camera;
+
+struct MeshData { // UniformMeshStruct
+    mat4 cframe;
+    vec3 base_color;
+    vec3 emission_factor;
+    float roughness;
+    float metalliness;
+    int albedo_id;
+    int normal_id;
+    int material_id;
+    int emission_id;
+    vec3 region_min; // packed vertex position bounds
+    vec3 region_extent;
+};
+
+layout(binding = 2) uniform Mesh {
+    MeshData data;
+} batch;
+
+layout(std430, binding = 8) readonly buffer Instances {
+    mat4 cframes[]; // indexed by gl_InstanceIndex (includes firstInstance)
+} instances;
+
+struct Draw { // IndirectDrawStruct, only material slot is used
+    vec3 region_min;
+    uint slot;
+    vec4 unused[5];
+};
+
+layout(std430, binding = 9) readonly buffer Draws {
+    Draw draws[]; // indexed by gl_InstanceIndex, one draw per instance
+};
+
+layout(std430, binding = 12) readonly buffer Materials {
+    MeshData materials[];
+};
+
+vec3 octahedral_decode(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.x += v.x >= 0.0 ? -t : t;
+    v.y += v.y >= 0.0 ? -t : t;
+    return normalize(v);
+}
+
+invariant gl_Position; // same depth as depth prepass
+
+void main() {
+    MeshData mesh = GPU_DRIVEN? materials[draws[gl_InstanceIndex].slot] : batch.data;
+    vec3 inPosition = mesh.region_min + packedPosition.xyz * mesh.region_extent;
+    vec3 inNormal = octahedral_decode(packedNormal);
+    vec3 inTangent = octahedral_decode(packedTangent);
+    vec3 inBitangent = cross(inNormal, inTangent) * (packedPosition.w > 0.5 ? 1.0 : -1.0);
+
+    mat4 v = inverse(camera.view); // camera world 
+    mat4 cframe = instances.cframes[gl_InstanceIndex];
+    
+    vec3 T = normalize(vec3(cframe * vec4(inTangent,   0.0)));
+    vec3 B = normalize(vec3(cframe * vec4(inBitangent, 0.0)));
+    vec3 N = normalize(vec3(cframe * vec4(inNormal,    0.0)));
+    mat3 TBN = transpose(mat3(T, B, N));
+
+    outNormal = mat3(cframe) * inNormal;  // transpose(inverse(material.model))
+    outPosition = vec3(cframe * vec4(inPosition, 1.0)); //vec3(m[3][0], m[3][1], m[3][2]);
+    outViewPos = vec3(v[3][0], v[3][1], v[3][2]);
+
+    tan_space.TBN = TBN;
+    tan_space.viewPos = TBN * vec3(v[3][0], v[3][1], v[3][2]);
+    tan_space.fragPos = TBN * vec3(cframe * vec4(inPosition, 0.0));
+
+    outTexcoord = inTexcoord;
+    outMaterial = GPU_DRIVEN? draws[gl_InstanceIndex].slot : 0u;
+
+    gl_Position = camera.proj * camera.view * cframe * vec4(inPosition, 1.0);
+}
\ No newline at end of file
@@ -1,6 +1,8 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+layout(constant_id = 0) const bool GPU_DRIVEN = false; // material slot is read from draw buffer by gl_InstanceIndex
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inTexcoord;
@@ -16,13 +18,14 @@ layout(location = 4) out outTangentSpace{
     vec3 viewPos;
     vec3 fragPos;
 } tan_space;
+layout(location = 9) flat out uint outMaterial; // GPU_DRIVEN only
 
 layout(binding = 0) uniform Camera {
     mat4 view;
     mat4 proj;
 } camera;
 
-layout(binding = 2) uniform Mesh {
+struct MeshData { // UniformMeshStruct
     mat4 cframe;
     vec3 base_color;
     vec3 emission_factor;
@@ -32,25 +35,49 @@ layout(binding = 2) uniform Mesh {
     int normal_id;
     int material_id;
     int emission_id;
-} mesh;
+    vec3 region_min; // packed vertex position bounds
+    vec3 region_extent;
+};
+
+layout(binding = 2) uniform Mesh {
+    MeshData data;
+} batch;
+
+layout(std430, binding = 8) readonly buffer Instances {
+    mat4 cframes[]; // indexed by gl_InstanceIndex (includes firstInstance)
+} instances;
+
+struct Draw { // IndirectDrawStruct, only material slot is used
+    vec3 region_min;
+    uint slot;
+    vec4 unused[5];
+};
+
+layout(std430, binding = 9) readonly buffer Draws {
+    Draw draws[]; // indexed by gl_InstanceIndex, one draw per instance
+};
+
+invariant gl_Position; // same depth as depth prepass
 
 void main() {
     mat4 v = inverse(camera.view); // camera world 
+    mat4 cframe = instances.cframes[gl_InstanceIndex];
     
-    vec3 T = normalize(vec3(mesh.cframe * vec4(inTangent,   0.0)));
-    vec3 B = normalize(vec3(mesh.cframe * vec4(inBitangent, 0.0)));
-    vec3 N = normalize(vec3(mesh.cframe * vec4(inNormal,    0.0)));
+    vec3 T = normalize(vec3(cframe * vec4(inTangent,   0.0)));
+    vec3 B = normalize(vec3(cframe * vec4(inBitangent, 0.0)));
+    vec3 N = normalize(vec3(cframe * vec4(inNormal,    0.0)));
     mat3 TBN = transpose(mat3(T, B, N));
 
-    outNormal = mat3(mesh.cframe) * inNormal;  // transpose(inverse(material.model))
-    outPosition = vec3(mesh.cframe * vec4(inPosition, 1.0)); //vec3(m[3][0], m[3][1], m[3][2]);
+    outNormal = mat3(cframe) * inNormal;  // transpose(inverse(material.model))
+    outPosition = vec3(cframe * vec4(inPosition, 1.0)); //vec3(m[3][0], m[3][1], m[3][2]);
     outViewPos = vec3(v[3][0], v[3][1], v[3][2]);
 
     tan_space.TBN = TBN;
     tan_space.viewPos = TBN * vec3(v[3][0], v[3][1], v[3][2]);
-    tan_space.fragPos = TBN * vec3(mesh.cframe * vec4(inPosition, 0.0));
+    tan_space.fragPos = TBN * vec3(cframe * vec4(inPosition, 0.0));
 
     outTexcoord = inTexcoord;
+    outMaterial = GPU_DRIVEN? draws[gl_InstanceIndex].slot : 0u;
 
-    gl_Position = camera.proj * camera.view * mesh.cframe * vec4(inPosition, 1.0);
+    gl_Position = camera.proj * camera.view * cframe * vec4(inPosition, 1.0);
 }
\ No newline at end of file
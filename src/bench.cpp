@@ -0,0 +1,222 @@
+// Check and timing of SIMD kernels in simd.hpp against plain scalar loops,
+// and of loader extraction before the kernels (per element memcpy into temporary vectors) against single pass gather.
+// Built by bench.bat, `bench.exe` returns EXIT_FAILURE when any kernel output differs.
+
+#include "common.hpp"
+#include "simd.hpp"
+#include <random>
+
+const size_t BENCH_COUNT = 1000003; // odd, leaves a scalar tail in every kernel
+const uint32_t BENCH_REPEATS = 20;
+const size_t CHECK_LENGTHS[] = {0, 1, 2, 3, 7, 8, 9, 15, 16, 17, 31, 33, 63, 65, 1001};
+
+std::mt19937 random_engine(1);
+uint32_t failures = 0;
+
+//-------------------------------------------------------------------
+// scalar references
+
+void scalar_widen(const uint16_t* source, uint32_t* destination, size_t count){ for(size_t i = 0; i < count; i++) destination[i] = source[i]; }
+void scalar_widen(const uint8_t* source, uint32_t* destination, size_t count){ for(size_t i = 0; i < count; i++) destination[i] = source[i]; }
+void scalar_narrow(const uint32_t* source, uint16_t* destination, size_t count){ for(size_t i = 0; i < count; i++) destination[i] = (uint16_t)source[i]; }
+
+void scalar_gather(const char* source, uint32_t stride, size_t count, size_t size, Vertex* vertices, size_t member_offset)
+{
+    char* destination = reinterpret_cast<char*>(vertices) + member_offset;
+    for(size_t i = 0; i < count; i++) std::memcpy(destination + i * sizeof(Vertex), source + i * stride, size);
+}
+
+//-------------------------------------------------------------------
+
+/// best of `BENCH_REPEATS` runs in milliseconds
+template<typename FUNCTION>
+double best_time(FUNCTION function)
+{
+    double best = 1e30;
+    for(uint32_t r = 0; r < BENCH_REPEATS; r++){
+        auto begin = std::chrono::high_resolution_clock::now();
+        function();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - begin).count());
+    }
+    return best;
+}
+
+void report(const char* name, double before, double after, const char* before_name = "scalar", const char* after_name = "simd")
+{
+    msg::printl(name, ": ", before_name, " ", before, " ms, ", after_name, " ", after, " ms (x", before / after, ")");
+}
+
+void expect(bool equal, const char* name, size_t count, size_t offset)
+{
+    if(equal) return;
+    msg::error(name, " differs from scalar, count ", count, ", source offset ", offset);
+    failures++;
+}
+
+std::vector<char> random_bytes(size_t size)
+{
+    std::vector<char> bytes(size);
+    for(char& byte : bytes) byte = (char)random_engine();
+    return bytes;
+}
+
+//-------------------------------------------------------------------
+// loader extraction of tightly packed accessors, `previous_*` is the code `create_vertices`/`create_indices` had before simd.hpp
+
+std::vector<Vertex> previous_vertices(const char* positions, const char* normals, const char* texcoords, size_t count)
+{
+    std::vector<glm::vec3> position(count), normal(count);
+    std::vector<glm::vec2> texcoord(count);
+    for(uint32_t i = 0; i < count; i++) std::memcpy(&position[i], positions + i * sizeof(glm::vec3), sizeof(glm::vec3));
+    for(uint32_t i = 0; i < count; i++) std::memcpy(&normal[i], normals + i * sizeof(glm::vec3), sizeof(glm::vec3));
+    for(uint32_t i = 0; i < count; i++) std::memcpy(&texcoord[i], texcoords + i * sizeof(glm::vec2), sizeof(glm::vec2));
+
+    std::vector<Vertex> vertices(count);
+    for(uint32_t i = 0; i < count; i++) vertices[i] = Vertex(position[i], normal[i], texcoord[i]);
+    return vertices;
+}
+
+std::vector<Vertex> gathered_vertices(const char* positions, const char* normals, const char* texcoords, size_t count)
+{
+    std::vector<Vertex> vertices(count);
+    gather_vec3(positions, sizeof(glm::vec3), count, vertices.data(), offsetof(Vertex, position));
+    gather_vec3(normals, sizeof(glm::vec3), count, vertices.data(), offsetof(Vertex, normal));
+    gather_vec2(texcoords, sizeof(glm::vec2), count, vertices.data(), offsetof(Vertex, texcoord));
+    return vertices;
+}
+
+std::vector<uint32_t> previous_indices(const char* source, size_t count)
+{
+    std::vector<uint32_t> indices(count);
+    for(uint32_t i = 0; i < count; i++) std::memcpy(&indices[i], source + i * sizeof(uint16_t), sizeof(uint16_t));
+    return indices;
+}
+
+std::vector<uint32_t> widened_indices(const char* source, size_t count)
+{
+    std::vector<uint32_t> indices(count);
+    widen_indices(reinterpret_cast<const uint16_t*>(source), indices.data(), count);
+    return indices;
+}
+
+//-------------------------------------------------------------------
+// every length is checked at each source misalignment, source buffer ends exactly at the last element
+
+template<typename SOURCE, typename DESTINATION, typename SIMD, typename SCALAR>
+void check_indices(const char* name, SIMD simd, SCALAR scalar)
+{
+    for(size_t count : CHECK_LENGTHS) for(size_t offset = 0; offset < 4; offset++){
+        std::vector<char> bytes = random_bytes(offset + count * sizeof(SOURCE));
+        std::vector<SOURCE> source(count);
+        if(count > 0) std::memcpy(source.data(), bytes.data() + offset, count * sizeof(SOURCE));
+        if(std::is_same<SOURCE, uint32_t>::value) for(SOURCE& index : source) index &= 0xFFFF; // narrow expects 16-bit range
+
+        std::vector<DESTINATION> expected(count), result(count);
+        scalar(source.data(), expected.data(), count);
+        simd(source.data(), result.data(), count);
+        expect(expected == result, name, count, offset);
+    }
+}
+
+void check_gather(const char* name, size_t size, uint32_t stride)
+{
+    for(size_t count : CHECK_LENGTHS) for(size_t offset = 0; offset < 4; offset++){
+        std::vector<char> source = random_bytes(offset + (count? (count - 1) * stride + size : 0));
+        std::vector<Vertex> expected(count), result(count);
+
+        scalar_gather(source.data() + offset, stride, count, size, expected.data(), offsetof(Vertex, normal));
+        if(size == sizeof(glm::vec3)) gather_vec3(source.data() + offset, stride, count, result.data(), offsetof(Vertex, normal));
+        else gather_vec2(source.data() + offset, stride, count, result.data(), offsetof(Vertex, normal));
+
+        bool equal = true;
+        for(size_t i = 0; i < count; i++) equal &= std::memcmp(&expected[i].normal, &result[i].normal, size) == 0;
+        expect(equal, name, count, offset);
+    }
+}
+
+//-------------------------------------------------------------------
+
+int main()
+{
+    check_indices<uint16_t, uint32_t>("widen 16-bit", [](auto s, auto d, size_t c){ widen_indices(s, d, c); }, [](auto s, auto d, size_t c){ scalar_widen(s, d, c); });
+    check_indices<uint8_t, uint32_t>("widen 8-bit", [](auto s, auto d, size_t c){ widen_indices(s, d, c); }, [](auto s, auto d, size_t c){ scalar_widen(s, d, c); });
+    check_indices<uint32_t, uint16_t>("narrow 32-bit", narrow_indices, scalar_narrow);
+    check_gather("gather vec3", sizeof(glm::vec3), 12);
+    check_gather("gather vec3 stride", sizeof(glm::vec3), 44);
+    check_gather("gather vec2", sizeof(glm::vec2), 8);
+    check_gather("gather vec2 stride", sizeof(glm::vec2), 44);
+
+    if(failures != 0){
+        msg::error(failures, " checks failed");
+        return EXIT_FAILURE;
+    }
+    // extraction paths must produce the same vertices and indices
+    {
+        std::vector<char> positions = random_bytes(1001 * sizeof(glm::vec3)), normals = random_bytes(1001 * sizeof(glm::vec3)), texcoords = random_bytes(1001 * sizeof(glm::vec2));
+        std::vector<Vertex> expected = previous_vertices(positions.data(), normals.data(), texcoords.data(), 1001);
+        std::vector<Vertex> result = gathered_vertices(positions.data(), normals.data(), texcoords.data(), 1001);
+        bool equal = true;
+        for(size_t i = 0; i < expected.size(); i++){
+            equal &= std::memcmp(&expected[i].position, &result[i].position, sizeof(glm::vec3)) == 0;
+            equal &= std::memcmp(&expected[i].normal, &result[i].normal, sizeof(glm::vec3)) == 0;
+            equal &= std::memcmp(&expected[i].texcoord, &result[i].texcoord, sizeof(glm::vec2)) == 0;
+        }
+        expect(equal, "vertex extraction", 1001, 0);
+
+        std::vector<char> source = random_bytes(1001 * sizeof(uint16_t));
+        expect(previous_indices(source.data(), 1001) == widened_indices(source.data(), 1001), "index extraction", 1001, 0);
+    }
+
+    if(failures != 0){
+        msg::error(failures, " checks failed");
+        return EXIT_FAILURE;
+    }
+    msg::success("All SIMD kernels match scalar");
+
+    // timing, interleaved position/normal/texcoord source like most glTF exporters write
+    const uint32_t stride = 32;
+    std::vector<char> attributes = random_bytes(BENCH_COUNT * stride);
+    std::vector<Vertex> vertices(BENCH_COUNT);
+    std::vector<uint16_t> short_indices(BENCH_COUNT);
+    std::vector<uint8_t> byte_indices(BENCH_COUNT);
+    std::vector<uint32_t> indices(BENCH_COUNT);
+    for(uint16_t& index : short_indices) index = (uint16_t)random_engine();
+    for(uint8_t& index : byte_indices) index = (uint8_t)random_engine();
+
+    msg::printl("Kernel timing, ", BENCH_COUNT, " elements, best of ", BENCH_REPEATS);
+    report("widen 16-bit",
+        best_time([&]{ scalar_widen(short_indices.data(), indices.data(), BENCH_COUNT); }),
+        best_time([&]{ widen_indices(short_indices.data(), indices.data(), BENCH_COUNT); }));
+    report("widen 8-bit",
+        best_time([&]{ scalar_widen(byte_indices.data(), indices.data(), BENCH_COUNT); }),
+        best_time([&]{ widen_indices(byte_indices.data(), indices.data(), BENCH_COUNT); }));
+    report("narrow 32-bit",
+        best_time([&]{ scalar_narrow(indices.data(), short_indices.data(), BENCH_COUNT); }),
+        best_time([&]{ narrow_indices(indices.data(), short_indices.data(), BENCH_COUNT); }));
+    report("gather vec3",
+        best_time([&]{ scalar_gather(attributes.data(), stride, BENCH_COUNT, sizeof(glm::vec3), vertices.data(), offsetof(Vertex, position)); }),
+        best_time([&]{ gather_vec3(attributes.data(), stride, BENCH_COUNT, vertices.data(), offsetof(Vertex, position)); }));
+    report("gather vec2",
+        best_time([&]{ scalar_gather(attributes.data() + 24, stride, BENCH_COUNT, sizeof(glm::vec2), vertices.data(), offsetof(Vertex, texcoord)); }),
+        best_time([&]{ gather_vec2(attributes.data() + 24, stride, BENCH_COUNT, vertices.data(), offsetof(Vertex, texcoord)); }));
+
+    // whole extraction of one primitive, separate tightly packed position/normal/texcoord views and 16-bit indices
+    std::vector<char> positions = random_bytes(BENCH_COUNT * sizeof(glm::vec3));
+    std::vector<char> normals = random_bytes(BENCH_COUNT * sizeof(glm::vec3));
+    std::vector<char> texcoords = random_bytes(BENCH_COUNT * sizeof(glm::vec2));
+    std::vector<char> index_bytes = random_bytes(BENCH_COUNT * sizeof(uint16_t));
+    float sink = 0;
+
+    msg::printl("Loader extraction, previous loops against single pass gather");
+    report("create_vertices",
+        best_time([&]{ sink += previous_vertices(positions.data(), normals.data(), texcoords.data(), BENCH_COUNT)[BENCH_COUNT / 2].position.x; }),
+        best_time([&]{ sink += gathered_vertices(positions.data(), normals.data(), texcoords.data(), BENCH_COUNT)[BENCH_COUNT / 2].position.x; }),
+        "previous", "gather");
+    report("create_indices",
+        best_time([&]{ sink += (float)previous_indices(index_bytes.data(), BENCH_COUNT)[BENCH_COUNT / 2]; }),
+        best_time([&]{ sink += (float)widened_indices(index_bytes.data(), BENCH_COUNT)[BENCH_COUNT / 2]; }),
+        "previous", "widen");
+    if(sink == 1.0f) msg::printl(""); // keeps results alive
+
+    return EXIT_SUCCESS;
+}
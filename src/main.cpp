@@ -42,7 +42,7 @@ void render_thread_function()
             if (glfwGetTime() - time_begin >= 1.0)
             {
                 std::string title(TITLE);
-                glfwSetWindowTitle(window, (title + " (" + std::to_string(frame_count) + ')').c_str());
+                glfwSetWindowTitle(window, (title + " (" + std::to_string(frame_count) + ", " + app.get_stats() + ')').c_str());
                 time_begin = glfwGetTime();
                 frame_count = 0;
             }
@@ -62,6 +62,9 @@ int main(int argc, char *argv[])
     for(uint32_t i = 0; i < argc; i++){
         msg::print( *(argv + i), " ");
         if(std::strcmp(*(argv + i),"debug") == 0) APP_DEBUG = true;
+        if(std::strcmp(*(argv + i),"packed") == 0) PACKED_VERTICES = true;
+        if(std::strcmp(*(argv + i),"prepass") == 0) DEPTH_PREPASS = true;
+        if(std::strcmp(*(argv + i),"gpu") == 0) GPU_DRIVEN = true;
     } 
     msg::printl();
     